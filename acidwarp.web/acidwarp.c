@@ -466,8 +466,13 @@ int GO = TRUE;
 int SKIP = FALSE;
 int NP = FALSE;
 int LOCK = FALSE;
-UCHAR MainPalArray [256 * 3];
-UCHAR TargetPalArray [256 * 3];
+PalRing MainPal, TargetPal;
+
+static void loadPal(PalRing *ring, int paletteType) {
+    UCHAR palArray[256 * 3];
+    initPalArray(palArray, paletteType);
+    palring_load(ring, palArray);
+}
 int FadeCompleteFlag = 0;
 
 // SDL2 globals
@@ -518,18 +523,21 @@ EM_JS(int, get_canvas_height, (), {
 });
 #endif
 
-// Helper to convert 8-bit framebuffer to 32-bit RGBA
+// Helper to convert 8-bit framebuffer to 32-bit RGBA: the palette is
+// expanded once, then each pixel is one table lookup
 void convert_8bit_to_32bit(const UCHAR *src, Uint32 *dst, int width, int height, const UCHAR *palette) {
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int idx = src[y * width + x];
-            /* Scale 6-bit VGA palette (0-63) to 8-bit (0-255) */
-            Uint8 r = (palette[idx * 3 + 0] << 2) | (palette[idx * 3 + 0] >> 4);
-            Uint8 g = (palette[idx * 3 + 1] << 2) | (palette[idx * 3 + 1] >> 4);
-            Uint8 b = (palette[idx * 3 + 2] << 2) | (palette[idx * 3 + 2] >> 4);
-            dst[y * width + x] = (0xFFU << 24) | (r << 16) | (g << 8) | b;
-        }
+    Uint32 argb[256];
+    long n = (long)width * height;
+
+    for (int i = 0; i < 256; ++i) {
+        /* Scale 6-bit VGA palette (0-63) to 8-bit (0-255) */
+        Uint32 r = (palette[i * 3 + 0] << 2) | (palette[i * 3 + 0] >> 4);
+        Uint32 g = (palette[i * 3 + 1] << 2) | (palette[i * 3 + 1] >> 4);
+        Uint32 b = (palette[i * 3 + 2] << 2) | (palette[i * 3 + 2] >> 4);
+        argb[i] = (0xFFU << 24) | (r << 16) | (g << 8) | b;
     }
+    for (long i = 0; i < n; ++i)
+        dst[i] = argb[src[i]];
 }
 
 // Render current frame to screen
@@ -561,7 +569,7 @@ void render_frame(void) {
             glDisableVertexAttribArray(posLoc);
         } else {
             /* Classic mode: render pixel buffer as texture */
-            convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
+            convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, palring_colors(&MainPal));
             
             glBindTexture(GL_TEXTURE_2D, classic_texture);
             glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, XMax, YMax, GL_RGBA, GL_UNSIGNED_BYTE, pixel_buffer);
@@ -589,7 +597,7 @@ void render_frame(void) {
         if (modern_mode) {
             render_modern_effect(pixel_buffer, XMax, YMax);
         } else {
-            convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
+            convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, palring_colors(&MainPal));
         }
         SDL_UpdateTexture(texture, NULL, pixel_buffer, XMax * sizeof(Uint32));
         SDL_RenderClear(renderer);
@@ -600,7 +608,7 @@ void render_frame(void) {
     if (modern_mode) {
         render_modern_effect(pixel_buffer, XMax, YMax);
     } else {
-        convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
+        convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, palring_colors(&MainPal));
     }
     SDL_UpdateTexture(texture, NULL, pixel_buffer, XMax * sizeof(Uint32));
     SDL_RenderClear(renderer);
@@ -867,7 +875,7 @@ int generate_image(int imageFuncNum, UCHAR *buf_graf, int xcenter, int ycenter,
 
 void newpal(void) {
     int pt = RANDOM(NUM_PALETTE_TYPES + 1);
-    initPalArray(MainPalArray, pt);
+    loadPal(&MainPal, pt);
 }
 
 int checkinput(void) { return 0; }
@@ -1022,8 +1030,8 @@ void main_loop_iteration(void) {
     switch (current_state) {
         case STATE_LOGO_DISPLAY:
             if (!logo_initialized) {
-                initPalArray(MainPalArray, RGBW_LIGHTNING_PAL);
-                initPalArray(TargetPalArray, RGBW_LIGHTNING_PAL);
+                loadPal(&MainPal, RGBW_LIGHTNING_PAL);
+                loadPal(&TargetPal, RGBW_LIGHTNING_PAL);
                 writeBitmapImageToArray(buf_graf, NOAHS_FACE, XMax, YMax);
                 ltime = time(NULL);
                 mtime = ltime + logo_time;
@@ -1037,7 +1045,7 @@ void main_loop_iteration(void) {
             }
             
             processinput();
-            if (GO) rollMainPalArrayAndLoadDACRegs(MainPalArray);
+            if (GO) rollMainPalArrayAndLoadDACRegs(&MainPal);
             render_frame();
             break;
 
@@ -1052,7 +1060,7 @@ void main_loop_iteration(void) {
             }
             
             processinput();
-            if (GO) rolNFadeBlkMainPalArrayNLoadDAC(MainPalArray);
+            if (GO) rolNFadeBlkMainPalArrayNLoadDAC(&MainPal);
             render_frame();
             break;
 
@@ -1072,7 +1080,7 @@ void main_loop_iteration(void) {
 
             /* Create new target palette */
             paletteTypeNum = RANDOM(NUM_PALETTE_TYPES + 1);
-            initPalArray(TargetPalArray, paletteTypeNum);
+            loadPal(&TargetPal, paletteTypeNum);
             
             FadeCompleteFlag = 0;
             current_state = STATE_FADE_IN;
@@ -1090,7 +1098,7 @@ void main_loop_iteration(void) {
             }
             
             processinput();
-            if (GO) rolNFadeMainPalAryToTargNLodDAC(MainPalArray, TargetPalArray);
+            if (GO) rolNFadeMainPalAryToTargNLodDAC(&MainPal, &TargetPal);
             render_frame();
             break;
 
@@ -1103,7 +1111,7 @@ void main_loop_iteration(void) {
             }
             
             processinput();
-            if (GO) rollMainPalArrayAndLoadDACRegs(MainPalArray);
+            if (GO) rollMainPalArrayAndLoadDACRegs(&MainPal);
             if (NP) { newpal(); NP = FALSE; }
             render_frame();
             break;
@@ -1118,9 +1126,9 @@ void main_loop_iteration(void) {
             processinput();
             if (GO) {
                 if (fade_dir)
-                    rolNFadeBlkMainPalArrayNLoadDAC(MainPalArray);
+                    rolNFadeBlkMainPalArrayNLoadDAC(&MainPal);
                 else
-                    rolNFadeWhtMainPalArrayNLoadDAC(MainPalArray);
+                    rolNFadeWhtMainPalArrayNLoadDAC(&MainPal);
             }
             render_frame();
             break;
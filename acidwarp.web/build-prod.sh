@@ -6,7 +6,21 @@ set -e
 
 echo "Building Acidwarp for production..."
 
-emcc acidwarp.c bit_map.c lut.c palinit.c rolnfade.c warp_text.c \
+# The sine, angle and distance tables come from lutgen, which has to run
+# on the build machine, not in the browser
+${HOSTCC:-cc} -O2 -I../acidwarp ../acidwarp/lutgen.c -lm -o lutgen
+./lutgen lut_tables.c
+
+emcc acidwarp.c \
+    lut_tables.c \
+    ../acidwarp/bit_map.c \
+    ../acidwarp/lut.c \
+    ../acidwarp/lut_span.c \
+    ../acidwarp/palinit.c \
+    ../acidwarp/rng.c \
+    ../acidwarp/rolnfade.c \
+    ../acidwarp/warp_text.c \
+    -I../acidwarp \
     -s USE_SDL=2 \
     -s WASM=1 \
     -s ALLOW_MEMORY_GROWTH=1 \
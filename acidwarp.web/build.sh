@@ -6,11 +6,19 @@ set -e
 
 echo "Building Acidwarp for WebGL..."
 
+# The sine, angle and distance tables come from lutgen, which has to run
+# on the build machine, not in the browser
+${HOSTCC:-cc} -O2 -I../acidwarp ../acidwarp/lutgen.c -lm -o lutgen
+./lutgen lut_tables.c
+
 emcc acidwarp.c \
+    lut_tables.c \
     ../acidwarp/bit_map.c \
     ../acidwarp/lut.c \
+    ../acidwarp/lut_span.c \
     ../acidwarp/palinit.c \
     ../acidwarp/rolnfade.c \
+    ../acidwarp/rng.c \
     ../acidwarp/warp_text.c \
     -I../acidwarp \
     -sUSE_SDL=2 \
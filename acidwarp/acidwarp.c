@@ -12,7 +12,6 @@
 #define MAX_UNIQUE_INDICES 10
 #define MAX_COLOR_VALUE 255
 #define BUFFER_DEBUG_PRINT_COUNT 32
-#define ANGLE_UNIT 256
 #define NUM_IMAGE_FUNCTIONS 40
 #define NOAHS_FACE   0
 
@@ -32,12 +31,21 @@
 #include "acidwarp.h"
 #include "lut.h"
 #include "bit_map.h"
+#include "convert.h"
 #include "palinit.h"
 #include "rolnfade.h"
 #include "renderer_gl.h"
+#include "generate.h"
+#include "imgcache.h"
+#include "morph.h"
+#include "pan.h"
+#include "polar.h"
+#include "pregen.h"
+#include "userpat.h"
+#include "workpool.h"
 
 // Renderer selection enum
-typedef enum { RENDERER_SDL, RENDERER_OPENGL } RendererType;
+typedef enum { RENDERER_SDL, RENDERER_OPENGL, RENDERER_GL_CLASSIC, RENDERER_SDL_INDEXED } RendererType;
 static RendererType renderer_type = RENDERER_SDL;
 
 // Parse renderer flag
@@ -45,6 +53,10 @@ void parse_renderer_flag(int argc, char *argv[]) {
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--renderer=opengl") == 0) {
             renderer_type = RENDERER_OPENGL;
+        } else if (strcmp(argv[i], "--renderer=gl-classic") == 0) {
+            renderer_type = RENDERER_GL_CLASSIC;
+        } else if (strcmp(argv[i], "--renderer=sdl-indexed") == 0) {
+            renderer_type = RENDERER_SDL_INDEXED;
         } else if (strcmp(argv[i], "--renderer=sdl") == 0) {
             renderer_type = RENDERER_SDL;
         }
@@ -53,6 +65,7 @@ void parse_renderer_flag(int argc, char *argv[]) {
 
 // Forward declarations
 void restoreOldVideoMode(void);
+void panKey(SDL_Keycode key);
 
 // Modern input state (must be before any function that uses them)
 bool is_paused = false;
@@ -65,35 +78,22 @@ bool fade_dir = true;
 static const int ROTATION_DELAY_DEFAULT = 30000;
 static const int LOGO_TIME_DEFAULT = 4;
 static const int IMAGE_TIME_DEFAULT = 20;
+static const double PROGRESSIVE_TICK_MS = 10.0; // refinement time per palette tick
 
 int ROTATION_DELAY = ROTATION_DELAY_DEFAULT;
 int logo_time = LOGO_TIME_DEFAULT, image_time = IMAGE_TIME_DEFAULT;
 int XMax = 0, YMax = 0;
 uint8_t *buf_graf = NULL;
+bool image_changed = true;      // buf_graf differs from what the GPU has
 bool FadeCompleteFlag = false;
 
 // SDL2 globals
 SDL_Window *window = NULL;
 SDL_Renderer *renderer = NULL;
 SDL_Texture *texture = NULL;
-
-// Helper to convert 8-bit framebuffer to 32-bit RGBA
-void convert_8bit_to_32bit(const uint8_t *src, Uint32 *dst, int width, int height, const uint8_t *palette) {
-    DBG_PRINT("[DEBUG] Enter convert_8bit_to_32bit\n");
-    DBG_PRINT("[DEBUG] palette[0-8]: %d %d %d %d %d %d %d %d %d\n", palette[0], palette[1], palette[2], palette[3], palette[4], palette[5], palette[6], palette[7], palette[8]);
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int idx = src[y * width + x];
-            /* Scale 6-bit VGA palette (0-63) to 8-bit (0-255) */
-            Uint8 r = (palette[idx * COLOR_CHANNELS + 0] << 2) | (palette[idx * COLOR_CHANNELS + 0] >> 4);
-            Uint8 g = (palette[idx * COLOR_CHANNELS + 1] << 2) | (palette[idx * COLOR_CHANNELS + 1] >> 4);
-            Uint8 b = (palette[idx * COLOR_CHANNELS + 2] << 2) | (palette[idx * COLOR_CHANNELS + 2] >> 4);
-            dst[y * width + x] = (0xFFU << 24) | (r << 16) | (g << 8) | b;
-        }
-    }
-    DBG_PRINT("[DEBUG] Exit convert_8bit_to_32bit\n");
-    DBG_PRINT("[DEBUG] palette[0-8]: %d %d %d %d %d %d %d %d %d\n", palette[0], palette[1], palette[2], palette[3], palette[4], palette[5], palette[6], palette[7], palette[8]);
-}
+SDL_Surface *index_surface = NULL;     // sdl-indexed: buf_graf as an 8 bit surface
+double frame_prep_ms = 0.0;            // palette onto the frame, up to the flip
+long frame_prep_count = 0;
 
 // Helper to process SDL events and handle quit
 void handle_sdl_events(void) {
@@ -123,6 +123,8 @@ void handle_sdl_events(void) {
                 }
             } else if (key == SDLK_h) {
                 printf("Hotkeys: [SPACE]=Pause [N]=Next [L]=Lock [F]=Fullscreen [ESC]=Quit\n");
+            } else {
+                panKey(key);
             }
         }
     }
@@ -206,339 +208,339 @@ void makeShuffledList(int *list, int listSize)
     }
 }
 
-int generate_image(int imageFuncNum, uint8_t *buf_graf, int xcenter, int ycenter, int xmax, int ymax, int colormax)
-{
-  long x, y, dx, dy, dist, angle;
-  long color;
-  
-  long a1, a2, a3, a4, x1,x2,x3,x4,y1,y2,y3,y4;
-  
-  x1 = RANDOM(40)-20;  x2 = RANDOM(40)-20;  x3 = RANDOM(40)-20;  x4 = RANDOM(40)-20;
-  y1 = RANDOM(40)-20;  y2 = RANDOM(40)-20;  y3 = RANDOM(40)-20;  y4 = RANDOM(40)-20;
-  
-  a1 = RANDOM(ANGLE_UNIT);  a2 = RANDOM(ANGLE_UNIT);  a3 = RANDOM(ANGLE_UNIT);  a4 = RANDOM(ANGLE_UNIT);
-  for (y = 0; y < ymax; ++y)
-    {
-      
-      for (x = 0; x < xmax; ++x)
-	{
-	  dx = x - xcenter;
-	  dy = y - ycenter;
-	  
-	  dist  = lut_dist (dx, dy);
-	  angle = lut_angle (dx, dy);
-	  
-	  switch (imageFuncNum)
-	    {
-	      /* case -1:	Eight Arm Star -- produces weird discontinuity
-                color = dist+ lut_sin(angle * (200 - dist)) / 32;
-						break;
-						*/
-	    case 0: /* Rays plus 2D Waves */
-	      color = angle + lut_sin (dist * 10) / 64 +
-		lut_cos (x * ANGLE_UNIT / xmax * 2) / 32 +
-		lut_cos (y * ANGLE_UNIT / ymax * 2) / 32;
-	      break;
-	      
-	    case 1:	/* Rays plus 2D Waves */
-	      color = angle + lut_sin (dist * 10) / 16 +
-		lut_cos (x * ANGLE_UNIT / xmax * 2) / 8 +
-		lut_cos (y * ANGLE_UNIT / ymax * 2) / 8;
-	      break;
-	      
-	    case 2:
-	      color = lut_sin (lut_dist(dx + x1, dy + y1) *  4) / 32 +
-		lut_sin (lut_dist(dx + x2, dy + y2) *  8) / 32 +
-		lut_sin (lut_dist(dx + x3, dy + y3) * 16) / 32 +
-		lut_sin (lut_dist(dx + x4, dy + y4) * 32) / 32;
-	      break;
-	      
-	    case 3:	/* Peacock */
-	      color = angle + lut_sin (lut_dist(dx + 20, dy) * 10) / 32 +
-		angle + lut_sin (lut_dist(dx - 20, dy) * 10) / 32;
-	      break;
-	      
-	    case 4:
-	      color = lut_sin (dist) / 16;
-	      break;
-	      
-	    case 5:	/* 2D Wave + Spiral */
-	      color = lut_cos (x * ANGLE_UNIT / xmax) / 8 +
-		lut_cos (y * ANGLE_UNIT / ymax) / 8 +
-		angle + lut_sin(dist) / 32;
-	      break;
-	      
-	    case 6:	/* Peacock, three centers */
-	      color = lut_sin (lut_dist(dx,      dy - 20) * 4) / 32+
-		lut_sin (lut_dist(dx + 20, dy + 20) * 4) / 32+
-		lut_sin (lut_dist(dx - 20, dy + 20) * 4) / 32;
-	      break;
-	      
-	    case 7:	/* Peacock, three centers */
-	      color = angle +
-		lut_sin (lut_dist(dx,      dy - 20) * 8) / 32+
-		lut_sin (lut_dist(dx + 20, dy + 20) * 8) / 32+
-		lut_sin (lut_dist(dx - 20, dy + 20) * 8) / 32;
-	      break;
-	      
-	    case 8:	/* Peacock, three centers */
-	      color = lut_sin (lut_dist(dx,      dy - 20) * 12) / 32+
-		lut_sin (lut_dist(dx + 20, dy + 20) * 12) / 32+
-		lut_sin (lut_dist(dx - 20, dy + 20) * 12) / 32;
-	      break;
-	      
-	    case 9:	/* Five Arm Star */
-	      color = dist + lut_sin (5 * angle) / 64;
-	      break;
-	      
-	    case 10:	/* 2D Wave */
-	      color = lut_cos (x * ANGLE_UNIT / xmax * 2) / 4 +
-		lut_cos (y * ANGLE_UNIT / ymax * 2) / 4;
-	      break;
-	      
-	    case 11:	/* 2D Wave */
-	      color = lut_cos (x * ANGLE_UNIT / xmax) / 8 +
-		lut_cos (y * ANGLE_UNIT / ymax) / 8;
-	      break;
-	      
-	    case 12:	/* Simple Concentric Rings */
-	      color = dist;
-	      break;
-	      
-	    case 13:	/* Simple Rays */
-	      color = angle;
-	      break;
-	      
-	    case 14:	/* Toothed Spiral Sharp */
-	      color = angle + lut_sin(dist * 8)/32;
-	      break;
-	      
-	    case 15:	/* Rings with sine */
-	      color = lut_sin(dist * 4)/32;
-	      break;
-	      
-	    case 16:	/* Rings with sine with sliding inner Rings */
-	      color = dist+ lut_sin(dist * 4) / 32;
-	      break;
-	      
-	    case 17:
-	      color = lut_sin(lut_cos(2 * x * ANGLE_UNIT / xmax)) / (20 + dist)
-                + lut_sin(lut_cos(2 * y * ANGLE_UNIT / ymax)) / (20 + dist);
-	      break;
-	      
-	    case 18:	/* 2D Wave */
-	      color = lut_cos(7 * x * ANGLE_UNIT / xmax)/(20 + dist) +
-		lut_cos(7 * y * ANGLE_UNIT / ymax)/(20 + dist);
-	      break;
-	      
-	    case 19:	/* 2D Wave */
-	      color = lut_cos(17 * x * ANGLE_UNIT/xmax)/(20 + dist) +
-		lut_cos(17 * y * ANGLE_UNIT/ymax)/(20 + dist);
-	      break;
-	      
-	    case 20:	/* 2D Wave Interference */
-	      color = lut_cos(17 * x * ANGLE_UNIT / xmax) / 32 +
-		lut_cos(17 * y * ANGLE_UNIT / ymax) / 32 + dist + angle;
-	      break;
-	      
-	    case 21:	/* 2D Wave Interference */
-	      color = lut_cos(7 * x * ANGLE_UNIT / xmax) / 32 +
-		lut_cos(7 * y * ANGLE_UNIT / ymax) / 32 + dist;
-	      break;
-	      
-	    case 22:	/* 2D Wave Interference */
-	      color = lut_cos( 7 * x * ANGLE_UNIT / xmax) / 32 +
-		lut_cos( 7 * y * ANGLE_UNIT / ymax) / 32 +
-		lut_cos(11 * x * ANGLE_UNIT / xmax) / 32 +
-		lut_cos(11 * y * ANGLE_UNIT / ymax) / 32;
-	      break;
-	      
-	    case 23:
-	      color = lut_sin (angle * 7) / 32;
-	      break;
-	      
-	    case 24:
-	      color = lut_sin (lut_dist(dx + x1, dy + y1) * 2) / 12 +
-		lut_sin (lut_dist(dx + x2, dy + y2) * 4) / 12 +
-		lut_sin (lut_dist(dx + x3, dy + y3) * 6) / 12 +
-		lut_sin (lut_dist(dx + x4, dy + y4) * 8) / 12;
-	      break;
-	      
-	    case 25:
-	      color = angle + lut_sin (lut_dist(dx + x1, dy + y1) * 2) / 16 +
-		angle + lut_sin (lut_dist(dx + x2, dy + y2) * 4) / 16 +
-		lut_sin (lut_dist(dx + x3, dy + y3) * 6) /  8 +
-		lut_sin (lut_dist(dx + x4, dy + y4) * 8) /  8;
-	      break;
-	      
-	    case 26:
-	      color = angle + lut_sin (lut_dist(dx + x1, dy + y1) * 2) / 12 +
-		angle + lut_sin (lut_dist(dx + x2, dy + y2) * 4) / 12 +
-		angle + lut_sin (lut_dist(dx + x3, dy + y3) * 6) / 12 +
-		angle + lut_sin (lut_dist(dx + x4, dy + y4) * 8) / 12;
-	      break;
-	      
-	    case 27:
-	      color = lut_sin (lut_dist(dx + x1, dy + y1) * 2) / 32 +
-		lut_sin (lut_dist(dx + x2, dy + y2) * 4) / 32 +
-		lut_sin (lut_dist(dx + x3, dy + y3) * 6) / 32 +
-		lut_sin (lut_dist(dx + x4, dy + y4) * 8) / 32;
-	      break;
-
-	    case 28:	/* Random Curtain of Rain (in strong wind) */
-	      if (y == 0 || x == 0)
-		color = RANDOM (16);
-	      else
-		color = (  *(buf_graf + (xmax *  y   ) + (x-1))
-			   + *(buf_graf + (xmax * (y-1)) +    x)) / 2
-                  + RANDOM (16) - 8;
-	      break;
-	      
-	    case 29:
-	      if (y == 0 || x == 0)
-		color = RANDOM (1024);
-	      else
-		color = dist/6 + (*(buf_graf + (xmax * y    ) + (x-1))
-				  +  *(buf_graf + (xmax * (y-1)) +    x)) / 2
-		+ RANDOM (16) - 8;
-	      break;
-	      
-	    case 30:
-	      color = lut_sin (lut_dist(dx,     dy - 20) * 4) / 32 ^
-		lut_sin (lut_dist(dx + 20,dy + 20) * 4) / 32 ^
-		lut_sin (lut_dist(dx - 20,dy + 20) * 4) / 32;
-	      break;
-	      
-	    case 31:
-	      color = (angle % (ANGLE_UNIT/4)) ^ dist;
-	      break;
-	      
-	    case 32:
-	      color = dy ^ dx;
-	      break;
-	      
-	    case 33:	/* Variation on Rain */
-	      if (y == 0 || x == 0)
-		color = RANDOM (16);
-	      else
-		color = (  *(buf_graf + (xmax *  y   ) + (x-1))
-			   + *(buf_graf + (xmax * (y-1)) +  x   )  ) / 2;
-	      
-	      color += RANDOM (2) - 1;
-	      
-	      if (color < 64)
-		color += RANDOM (16) - 8;
-	      break; 
-	      
-	    case 34:	/* Variation on Rain */
-	      if (y == 0 || x == 0)
-		color = RANDOM (16);
-	      else
-		color = (  *(buf_graf + (xmax *  y   ) + (x-1))
-			   + *(buf_graf + (xmax * (y-1)) +  x   )  ) / 2;
-	      
-	      if (color < 100)
-		color += RANDOM (16) - 8;
-	      break;
-	      
-	    case 35:
-	      color = angle + lut_sin(dist * 8)/32;
-	      dx = x - xcenter;
-	      dy = (y - ycenter)*2;
-	      dist  = lut_dist (dx, dy);
-          angle = lut_angle (dx, dy);
-          color = (color + angle + lut_sin(dist * 8)/32) / 2;
-	  break;
-	  
-	    case 36:
-	      color = angle + lut_sin (dist * 10) / 16 +
-		lut_cos (x * ANGLE_UNIT / xmax * 2) / 8 +
-		lut_cos (y * ANGLE_UNIT / ymax * 2) / 8;
-	      dx = x - xcenter;
-	      dy = (y - ycenter)*2;
-	      dist  = lut_dist (dx, dy);
-	      angle = lut_angle (dx, dy);
-	      color = (color + angle + lut_sin(dist * 8)/32) / 2;
-	      break;
-	      
-	    case 37:
-	      color = angle + lut_sin (dist * 10) / 16 +
-		lut_cos (x * ANGLE_UNIT / xmax * 2) / 8 +
-		lut_cos (y * ANGLE_UNIT / ymax * 2) / 8;
-	      dx = x - xcenter;
-	      dy = (y - ycenter)*2;
-	      dist  = lut_dist (dx, dy);
-          angle = lut_angle (dx, dy);
-          color = (color + angle + lut_sin (dist * 10) / 16 +
-		   lut_cos (x * ANGLE_UNIT / xmax * 2) / 8 +
-		   lut_cos (y * ANGLE_UNIT / ymax * 2) / 8)  /  2;
-	  break;
-	  
-	    case 38:
-	      if (dy%2)
-		{
-		  dy *= 2;
-		  dist  = lut_dist (dx, dy);
-		  angle = lut_angle (dx, dy);
-		}
-	      color = angle + lut_sin(dist * 8)/32;
-	      break;
-	      
-	    case 39:
-	      color = (angle % (ANGLE_UNIT/4)) ^ dist;
-	      dx = x - xcenter;
-	      dy = (y - ycenter)*2;
-	      dist = lut_dist (dx, dy);
-	      angle = lut_angle (dx, dy);
-	      color = (color +  ((angle % (ANGLE_UNIT/4)) ^ dist)) / 2;
-	      break;
-	      
-	    case 40:
-	      color = dy ^ dx;
-	      dx = x - xcenter;
-	      dy = (y - ycenter)*2;
-	      color = (color +  (dy ^ dx)) / 2;
-	      break;
-
-	    default:
-	      color = RANDOM (colormax - 1) + 1;
-	      break;
-	    }
-	  
-	  color = color % (colormax-1);
-	  
-	  if (color < 0)
-	    color += (colormax - 1);
-	  
-	  ++color;
-          /* color 0 is never used, so all colors are from 1 through 255 */
-	  
-	  *(buf_graf + (xmax * y) + x) = (uint8_t)color;
-          /* Store the color in the buffer */
-	}
-      /* end for (y = 0; y < ymax; ++y)	*/
-    }
-  /* end for (x = 0; x < xmax; ++x)	*/
-  
-#if 0	/* For diagnosis, put palette display line at top of new image	*/
-  for (x = 0; x < xmax; ++x)
-    {
-      color = (x <= 255) ? x : 0;
-      
-      for (y = 0; y < 3; ++y)
-	*(buf_graf + (xmax * y) + x) = (uint8_t)color;
-    }
-#endif
-  
-  return (0);
-}
-
 // Window size defaults
 int window_width = 319;
 int window_height = 199;
 int fullscreen = 0;
+int thread_count = 0; // 0 means one worker per CPU core
+int progressive = 0;   // refine new images on screen instead of in the background
+int morph = 0;         // --morph: move the geometry, a new index buffer every frame
+int pan = 0;           // --pan: move around and zoom out of the pattern's plane
+int seed_given = 0;
+uint64_t session_seed = 0; // --seed N replays a session exactly
 
 int userOptionImageFuncNum = -1; // -1 means random; can be set via --image-func argument
+const char *pattern_file = NULL; // --pattern-file adds its patterns to the shuffle
+
+/* The classic patterns first, then the loaded ones */
+int imageFuncCount(void)
+{
+  return NUM_IMAGE_FUNCTIONS + userpat_count();
+}
+
+int imageFuncFromList(int entry)
+{
+  return (entry < NUM_IMAGE_FUNCTIONS) ? entry : USERPAT_FIRST + (entry - NUM_IMAGE_FUNCTIONS);
+}
+
+/* Draws the parameters for the next image in the shuffled list */
+void drawNextImageParams(GenParams *params, int *imageFuncList, int *imageFuncListIndex)
+{
+  if (++*imageFuncListIndex >= imageFuncCount())
+    {
+      *imageFuncListIndex = 0;
+      makeShuffledList(imageFuncList, imageFuncCount());
+    }
+  gen_draw_params(params,
+                  (userOptionImageFuncNum < 0) ?
+                  imageFuncFromList(imageFuncList[*imageFuncListIndex]) :
+                  userOptionImageFuncNum,
+                  XMax/2, YMax/2, XMax, YMax, MAX_COLOR_VALUE);
+}
+
+/* ... and starts generating it in the background */
+GenParams requested_params;
+
+void requestNextImage(int *imageFuncList, int *imageFuncListIndex)
+{
+  drawNextImageParams(&requested_params, imageFuncList, imageFuncListIndex);
+  pregen_request(&requested_params);
+}
+
+/* With --morph the image on screen is remade for every frame. The next
+ * frame is made in the background into the buffer that is not on screen,
+ * and swapped in as soon as it is done.
+ */
+Morph morph_state;
+bool morphing = false;
+double morph_clock_ms;
+
+void morphRequestFrame(void)
+{
+  GenParams params;
+  double now = MSEC_NOW();
+
+  morph_advance(&morph_state, now - morph_clock_ms);
+  morph_clock_ms = now;
+  morph_params(&morph_state, &params);
+  pregen_request_frame(&params, morph_state.pc);
+}
+
+void morphStart(const GenParams *params)
+{
+  if (!morph || !morph_applies(params->imageFuncNum))
+    return;
+  morph_begin(&morph_state, params);
+  morph_clock_ms = MSEC_NOW();
+  morphing = true;
+  morphRequestFrame();
+}
+
+/* TRUE if a new frame was swapped into buf_graf */
+bool morphTick(void)
+{
+  GenStats stats;
+
+  if (!morphing || !pregen_ready())
+    return false;
+  if (pregen_take(&buf_graf, &stats) != 0) {
+    morphRequestFrame();      /* out of memory: the last frame stays up */
+    return false;
+  }
+  image_changed = true;
+  morph_frame_done(&morph_state, stats.ms);
+  morphRequestFrame();
+  return true;
+}
+
+/* Frees the background thread for the next image */
+void morphStop(void)
+{
+  if (!morphing)
+    return;
+  while (!pregen_ready())
+    SDL_Delay(1);
+  pregen_take(&buf_graf, NULL);
+  morph_end(&morph_state);
+  morphing = false;
+  if (morph_state.frames > 0)
+    printf("[INFO] morph: %ld frames, %.1f ms each on average, worst %.1f ms (budget %.0f ms)\n",
+           morph_state.frames, morph_state.total_ms / morph_state.frames,
+           morph_state.worst_ms, MORPH_BUDGET_MS);
+}
+
+/* With --pan the arrow keys move the view over the plane of the pattern
+ * and +/- zoom it; buf_graf is redrawn from the tile cache whenever the
+ * view moves or tiles it was missing come in.
+ */
+#define PAN_STEP 32		/* screen pixels per key press */
+
+bool panning = false;
+long pan_x, pan_y;		/* plane point at the top left of the screen */
+int pan_level, pan_dirx, pan_diry, pan_missing;
+bool pan_moved;
+
+void panStart(const GenParams *params)
+{
+  if (!pan || !pan_applies(params->imageFuncNum))
+    return;
+  pan_set_pattern(params, buf_graf);
+  pan_x = pan_y = 0;
+  pan_level = pan_dirx = pan_diry = pan_missing = 0;
+  pan_moved = false;
+  panning = true;
+}
+
+/* Moves the view so that screen point (sx, sy) stays on the same plane
+ * point at the new level
+ */
+void panZoom(int level, long sx, long sy)
+{
+  level = MIN(MAX(level, 0), PAN_MAX_LEVEL);
+  pan_x += sx * ((1L << pan_level) - (1L << level));
+  pan_y += sy * ((1L << pan_level) - (1L << level));
+  pan_level = level;
+}
+
+void panKey(SDL_Keycode key)
+{
+  long step = PAN_STEP * (1L << pan_level);
+
+  if (!panning)
+    return;
+  pan_dirx = pan_diry = 0;
+  if (key == SDLK_LEFT) {
+    pan_x -= step;
+    pan_dirx = -1;
+  } else if (key == SDLK_RIGHT) {
+    pan_x += step;
+    pan_dirx = 1;
+  } else if (key == SDLK_UP) {
+    pan_y -= step;
+    pan_diry = -1;
+  } else if (key == SDLK_DOWN) {
+    pan_y += step;
+    pan_diry = 1;
+  } else if (key == SDLK_EQUALS || key == SDLK_PLUS) {
+    panZoom(pan_level - 1, XMax / 2, YMax / 2);
+  } else if (key == SDLK_MINUS) {
+    panZoom(pan_level + 1, XMax / 2, YMax / 2);
+  } else if (key == SDLK_HOME) {
+    pan_x = pan_y = 0;
+    pan_level = 0;
+  } else {
+    return;
+  }
+  pan_x = MIN(MAX(pan_x, -PAN_REACH), PAN_REACH - (XMax << pan_level));
+  pan_y = MIN(MAX(pan_y, -PAN_REACH), PAN_REACH - (YMax << pan_level));
+  pan_moved = true;
+}
+
+/* Never waits for tiles: what is not there yet is drawn on a later tick */
+void panTick(void)
+{
+  if (panning && (pan_moved || pan_missing)) {
+    pan_missing = pan_render(buf_graf, XMax, YMax, pan_x, pan_y, pan_level, pan_dirx, pan_diry);
+    image_changed = true;
+  }
+  pan_moved = false;
+}
+
+void panStop(void)
+{
+  size_t bytes;
+  int tiles;
+
+  if (!panning)
+    return;
+  panning = false;
+  pan_usage(&bytes, &tiles);
+  printf("[INFO] pan: %d tiles cached (%.1f of %.0f MB)\n",
+         tiles, bytes / (1024.0 * 1024.0), PAN_CACHE_BYTES / (1024.0 * 1024.0));
+}
+
+/* sdl-indexed: buf_graf itself is the pixels of an 8 bit surface, so
+   only its 256 colours change each tick; SDL's own blit looks them up
+   on the way to the window surface */
+bool indexedFrame(const uint8_t *pal)
+{
+  SDL_Surface *screen = SDL_GetWindowSurface(window);
+  SDL_Color colors[PALETTE_SIZE];
+  SDL_Rect dst;
+
+  if (!screen)
+    return false;
+  for (int i = 0; i < PALETTE_SIZE; ++i) {
+    /* Scale 6-bit VGA palette (0-63) to 8-bit (0-255) */
+    colors[i].r = (pal[i * COLOR_CHANNELS + 0] << 2) | (pal[i * COLOR_CHANNELS + 0] >> 4);
+    colors[i].g = (pal[i * COLOR_CHANNELS + 1] << 2) | (pal[i * COLOR_CHANNELS + 1] >> 4);
+    colors[i].b = (pal[i * COLOR_CHANNELS + 2] << 2) | (pal[i * COLOR_CHANNELS + 2] >> 4);
+    colors[i].a = 0xFF;
+  }
+  SDL_SetPaletteColors(index_surface->format->palette, colors, 0, PALETTE_SIZE);
+  index_surface->pixels = buf_graf;     // the generator swaps buffers
+  /* After [F] the window may not be the image's size any more */
+  dst.x = (screen->w - XMax) / 2;
+  dst.y = (screen->h - YMax) / 2;
+  dst.w = XMax;
+  dst.h = YMax;
+  if (screen->w != XMax || screen->h != YMax)
+    SDL_FillRect(screen, NULL, 0);
+  SDL_BlitSurface(index_surface, NULL, screen, &dst);
+  return true;
+}
+
+/* With gl-classic the indices go to the GPU only when they changed and
+   only the palette goes up every tick; pixels is not used then, nor
+   with sdl-indexed. The SDL paths are timed up to the flip, for the
+   figure printed at exit. */
+void presentImage(const uint8_t *pal, Uint32 *pixels)
+{
+  double start = MSEC_NOW();
+
+  if (renderer_type == RENDERER_GL_CLASSIC) {
+    if (image_changed)
+      renderer_gl_classic_set_image(buf_graf, XMax, YMax);
+    image_changed = false;
+    renderer_gl_classic_present(pal);
+    return;
+  }
+  if (renderer_type == RENDERER_SDL_INDEXED) {
+    if (!indexedFrame(pal))
+      return;
+  } else {
+    convert_8bit_to_32bit(buf_graf, pixels, XMax, YMax, pal);
+    SDL_UpdateTexture(texture, NULL, pixels, XMax * sizeof(Uint32));
+  }
+  frame_prep_ms += MSEC_NOW() - start;
+  frame_prep_count++;
+  if (renderer_type == RENDERER_SDL_INDEXED) {
+    SDL_UpdateWindowSurface(window);
+  } else {
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+  }
+}
+
+/* Palette time: the palette moves on a tick per ROTATION_DELAY of real
+   time, however long each pass of the loop takes, so conversion at a
+   large size or a stall does not slow the rolls and fades down; a slow
+   pass just moves it on several ticks at once. Time paused does not
+   count. */
+double pal_clock_ms = 0.0;      /* the ticks taken so far reach up to here */
+
+void palClockStart(void)
+{
+  pal_clock_ms = MSEC_NOW();
+}
+
+/* The palette, rolled by the ticks gone by since the last call (target
+   along with it, unless NULL), and with fade that many ticks further
+   into the fade. TRUE once the fade is complete. */
+bool palAdvance(PalRing *pal, PalRing *target, const PalFade *fade, long *fade_ticks)
+{
+  double tick_ms = MAX(ROTATION_DELAY, 1000) / 1000.0;
+  long ticks = (long)((MSEC_NOW() - pal_clock_ms) / tick_ms);
+  bool done = false;
+
+  /* Never a negative number of ticks, whatever the clock does */
+  if (ticks <= 0)
+    return false;
+  pal_clock_ms += ticks * tick_ms;
+  if (!is_running)
+    return false;
+  if (fade) {
+    *fade_ticks += ticks;
+    done = (palfade_seek(fade, pal, *fade_ticks) == DONE);
+  }
+  roll_rgb_palRings(pal, target, ticks);
+  return done;
+}
+
+/* Waits out a palette tick, putting morph frames on screen as they come */
+void waitPaletteTick(const uint8_t *pal, Uint32 *pixels)
+{
+  double end = MSEC_NOW() + ROTATION_DELAY / 1000.0;
+
+  if (!morphing) {
+    usleep(ROTATION_DELAY);
+    return;
+  }
+  while (MSEC_NOW() < end) {
+    if (morphTick())
+      presentImage(pal, pixels);
+    else
+      SDL_Delay(1);
+  }
+}
+
+/* With --progressive the image on screen is refined between palette ticks */
+GenProgress progress = { .done = TRUE };
+
+void progressiveTick(void)
+{
+  if (progress.done)
+    return;
+  image_changed = true;
+  if (!gen_progressive_step(&progress, PROGRESSIVE_TICK_MS))
+    return;
+  if (progress.failed)
+    printf("[WARN] progressive image: out of memory, keeping what was drawn\n");
+  else
+    printf("[INFO] progressive image: first pixels after %.1f ms, final after %.1f ms\n",
+           progress.first_ms, progress.final_ms);
+}
 
 void parse_args(int argc, char *argv[]) {
     for (int i = 1; i < argc; ++i) {
@@ -550,8 +552,27 @@ void parse_args(int argc, char *argv[]) {
             fullscreen = 1;
         } else if ((strcmp(argv[i], "--image-func") == 0 || strcmp(argv[i], "-f") == 0) && i+1 < argc) {
             userOptionImageFuncNum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--progressive") == 0) {
+            progressive = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && i+1 < argc) {
+            session_seed = strtoull(argv[++i], NULL, 0);
+            seed_given = 1;
+        } else if (strcmp(argv[i], "--cache-mb") == 0 && i+1 < argc) {
+            imgcache_budget = (size_t)MAX(atol(argv[++i]), 0) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && i+1 < argc) {
+            imgcache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--no-polar-cache") == 0) {
+            polar_cache_enabled = FALSE;
+        } else if (strcmp(argv[i], "--pattern-file") == 0 && i+1 < argc) {
+            pattern_file = argv[++i];
+        } else if (strcmp(argv[i], "--morph") == 0) {
+            morph = 1;
+        } else if (strcmp(argv[i], "--pan") == 0) {
+            pan = 1;
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            printf("Usage: %s [--width N] [--height N] [--fullscreen] [--image-func N]\n", argv[0]);
+            printf("Usage: %s [--width N] [--height N] [--fullscreen] [--image-func N] [--threads N] [--progressive] [--seed N] [--cache-mb N] [--cache-dir DIR] [--no-polar-cache] [--pattern-file FILE] [--morph] [--pan] [--renderer=sdl|sdl-indexed|gl-classic|opengl]\n", argv[0]);
             exit(0);
         }
     }
@@ -576,13 +597,28 @@ void handle_sigint(int sig) {
 
 void main (int argc, char *argv[])
 {
-  int imageFuncList[NUM_IMAGE_FUNCTIONS];
+  int imageFuncList[NUM_IMAGE_FUNCTIONS + USERPAT_MAX];
   int paletteTypeNum = 0, userPaletteTypeNumOptionFlag = FALSE;
   int imageFuncListIndex=0;
   time_t ltime, mtime;
 
   parse_args(argc, argv);
   parse_renderer_flag(argc, argv);
+
+  if (pattern_file != NULL) {
+      int loaded = userpat_load(pattern_file);
+      if (loaded < 0)
+          exit(1);
+      printf("[INFO] Loaded %d patterns from %s (--image-func %d..%d)\n",
+             loaded, pattern_file, USERPAT_FIRST, USERPAT_FIRST + loaded - 1);
+  }
+
+  if (seed_given)
+    rng_session_seed(session_seed);
+  else
+    RANDOMIZE();
+  printf("[INFO] Random seed %llu (--seed to replay this session)\n",
+         (unsigned long long)rng_session_seed_value());
   if (renderer_type == RENDERER_OPENGL) {
         renderer_gl_parse_flags(argc, argv);
         RendererGLConfig gl_cfg = { .width = window_width, .height = window_height };
@@ -596,20 +632,17 @@ void main (int argc, char *argv[])
         uint8_t intro_palette[PALETTE_SIZE * COLOR_CHANNELS];
         initPalArray(intro_palette, 0); // 0 = NOAHS_FACE
         writeBitmapImageToArray(intro_buf, NOAHS_FACE, window_width, window_height);
-        uint32_t *intro_rgba = (uint32_t*)malloc(window_width * window_height * sizeof(uint32_t));
-        convert_8bit_to_32bit(intro_buf, intro_rgba, window_width, window_height, intro_palette);
-        renderer_gl_show_intro_texture(intro_rgba, window_width, window_height, 7000); // Show for 7 seconds or until keypress
+        renderer_gl_show_intro(intro_buf, intro_palette, window_width, window_height, 7000); // Show for 7 seconds or until keypress
         free(intro_buf);
-        free(intro_rgba);
         // --- End Classic Intro ---
         renderer_gl_mainloop();
         return;
     }
 
   printf("Hotkeys: [p/SPACE]=Pause [n]=Next [l]=Lock [q/ESC]=Quit\n");
+  if (pan)
+    printf("Pan: [arrows]=Move [+/-]=Zoom in/out [HOME]=Back to the start\n");
 
-  RANDOMIZE();
-  
   /* Default options */
   userPaletteTypeNumOptionFlag = 0;       /* User Palette option is OFF */
   userOptionImageFuncNum = -1; /* No particular functions goes first. */
@@ -619,69 +652,85 @@ void main (int argc, char *argv[])
   printf ("\n\n%s\n", VERSION);
   
   graphicsinit();
+  lut_init(XMax, YMax);
+  workpool_init(thread_count);
+  printf("[INFO] Generating images with %d thread(s), %s lut spans%s\n", workpool_size(), lut_span_isa(),
+         progressive ? ", progressively" :
+         pregen_init(XMax, YMax) ? (morph ? ", morphing in the background" :
+                                    ", next image prepared in the background") : "");
+  if (morph && progressive)
+    printf("[INFO] --morph does not go with --progressive, images stay still\n");
+  if (pan && progressive) {
+    printf("[INFO] --pan does not go with --progressive\n");
+    pan = 0;
+  } else if (pan && morph) {
+    printf("[INFO] --pan is on, so images do not morph\n");
+    morph = 0;
+  }
+  if (pan && !pan_init(workpool_size(), PAN_CACHE_BYTES)) {
+    printf("[WARN] no threads for --pan\n");
+    pan = 0;
+  }
 
-  uint8_t MainPalArray [PALETTE_SIZE * COLOR_CHANNELS];
-  uint8_t TargetPalArray [PALETTE_SIZE * COLOR_CHANNELS];
-  initPalArray(MainPalArray, RGBW_LIGHTNING_PAL);
-  CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-  CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 19);
-  CALL_DEBUG_PALETTE_RANGE(MainPalArray, 236, 255);
-  initPalArray(TargetPalArray, RGBW_LIGHTNING_PAL);
+  uint8_t palArray [PALETTE_SIZE * COLOR_CHANNELS];
+  PalRing MainPal, TargetPal;
+  PalFade fade;
+  long fade_ticks;
+  initPalArray(palArray, RGBW_LIGHTNING_PAL);
+  palring_load(&MainPal, palArray);
+  palring_load(&TargetPal, palArray);
+  CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+  CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 19);
+  CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 236, 255);
 
   writeBitmapImageToArray(buf_graf, NOAHS_FACE, XMax, YMax);
 
+  /* The first image is made while the logo is up */
+  makeShuffledList(imageFuncList, imageFuncCount());
+  if (!progressive)
+    requestNextImage(imageFuncList, &imageFuncListIndex);
+
   if (logo_time != 0) {
     /* show the logo for a while */
     static Uint32 *rgb_frame = NULL;
-    if (!rgb_frame) rgb_frame = (Uint32 *)malloc(XMax * YMax * sizeof(Uint32));
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-    convert_8bit_to_32bit(buf_graf, rgb_frame, XMax, YMax, MainPalArray);
-    SDL_UpdateTexture(texture, NULL, rgb_frame, XMax * 4);
-    SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+    if (!rgb_frame && renderer_type == RENDERER_SDL)
+      rgb_frame = (Uint32 *)malloc(XMax * YMax * sizeof(Uint32));
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+    presentImage(palring_colors(&MainPal), rgb_frame);
     ltime=time(NULL);
     mtime=ltime + logo_time;
+    palClockStart();
     for(;;) {
       handle_sdl_events();
       processinput();
-      if(is_running)
-        rollMainPalArrayAndLoadDACRegs(MainPalArray);
+      palAdvance(&MainPal, NULL, NULL, NULL);
       if(skip_image)
         break;
       ltime=time(NULL);
       if(ltime>mtime) 
         break; 
       // Render updated palette/animation
-      CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-      convert_8bit_to_32bit(buf_graf, rgb_frame, XMax, YMax, MainPalArray);
-      SDL_UpdateTexture(texture, NULL, rgb_frame, XMax * 4);
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, NULL, NULL);
-      SDL_RenderPresent(renderer);
+      CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+      presentImage(palring_colors(&MainPal), rgb_frame);
       usleep(ROTATION_DELAY);
     }
+    palfade_begin(&fade, &MainPal, FADE_TO_BLACK, NULL);
+    fade_ticks = 0;
     while(!FadeCompleteFlag) {
       handle_sdl_events();
       processinput();
-      if(is_running)
-        rolNFadeBlkMainPalArrayNLoadDAC(MainPalArray);
+      FadeCompleteFlag = palAdvance(&MainPal, NULL, &fade, &fade_ticks);
       if(skip_image)
         break;
       // Render fade
-      CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-      convert_8bit_to_32bit(buf_graf, rgb_frame, XMax, YMax, MainPalArray);
-      SDL_UpdateTexture(texture, NULL, rgb_frame, XMax * 4);
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, NULL, NULL);
-      SDL_RenderPresent(renderer);
+      CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+      presentImage(palring_colors(&MainPal), rgb_frame);
       usleep(ROTATION_DELAY);
     }
     FadeCompleteFlag=!FadeCompleteFlag;
   } 
   
   skip_image = false;
-  makeShuffledList(imageFuncList, NUM_IMAGE_FUNCTIONS);
 
   long long frame_count = 0;
   long long last_fps_time = current_time_ms();
@@ -692,7 +741,8 @@ void main (int argc, char *argv[])
   static Uint32 *pixel_buffer = NULL;
   static int pixel_buffer_size = 0;
   int required_size = XMax * YMax;
-  if (!pixel_buffer || pixel_buffer_size != required_size) {
+  if (renderer_type == RENDERER_SDL &&
+      (!pixel_buffer || pixel_buffer_size != required_size)) {
       if (pixel_buffer) free(pixel_buffer);
       pixel_buffer = (Uint32*)malloc(required_size * sizeof(Uint32));
       pixel_buffer_size = required_size;
@@ -704,19 +754,40 @@ void main (int argc, char *argv[])
         SDL_Delay(10);
         continue;
     }
-    /* move to the next image */
-    if (++imageFuncListIndex >= NUM_IMAGE_FUNCTIONS)
-      {
-	imageFuncListIndex = 0;
-	makeShuffledList(imageFuncList, NUM_IMAGE_FUNCTIONS);
+    /* The next image is normally finished long before it is needed. If
+       it is not ('n' pressed while it was being made, or a short image
+       time), keep the window responsive until it is. */
+    if (!progressive && !pregen_ready()) {
+      double wait_start = MSEC_NOW();
+      while (!pregen_ready()) {
+        handle_sdl_events();
+        SDL_Delay(1);
       }
+      printf("[INFO] waited %.1f ms for the next image\n", MSEC_NOW() - wait_start);
+    }
 
     /* install a new image */
-    int gen_ok = generate_image(
-           (userOptionImageFuncNum < 0) ? 
-           imageFuncList[imageFuncListIndex] : 
-           userOptionImageFuncNum, 
-           buf_graf, XMax/2, YMax/2, XMax, YMax, MAX_COLOR_VALUE);
+    GenStats gen_stats;
+    int gen_ok = 0;
+    if (progressive) {
+      GenParams params;
+      drawNextImageParams(&params, imageFuncList, &imageFuncListIndex);
+      gen_progressive_begin(&progress, &params, buf_graf);
+      gen_stats = gen_last_stats;
+      if (progress.failed)
+        printf("[WARN] progressive image: out of memory, keeping what was drawn\n");
+      else if (progress.done)
+        printf("[INFO] progressive image: first pixels after %.1f ms, final after %.1f ms\n",
+               progress.first_ms, progress.final_ms);
+      else
+        printf("[INFO] progressive image: coarse pass in %.1f ms\n", progress.first_ms);
+    } else {
+      gen_ok = pregen_take(&buf_graf, &gen_stats);
+      if (gen_ok == 0) {
+        morphStart(&requested_params);
+        panStart(&requested_params);
+      }
+    }
     CALL_DEBUG_BUFFER(buf_graf, XMax+1, YMax+1);
     // Collect first 10 unique indices from buf_graf
     uint8_t unique_indices[MAX_UNIQUE_INDICES];
@@ -730,24 +801,42 @@ void main (int argc, char *argv[])
             if (num_unique == MAX_UNIQUE_INDICES) break;
         }
     }
-    CALL_DEBUG_PALETTE_INDICES(MainPalArray, unique_indices, num_unique);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 19);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 236, 255);
+    CALL_DEBUG_PALETTE_INDICES(palring_colors(&MainPal), unique_indices, num_unique);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 19);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 236, 255);
     if (gen_ok != 0) {
-        printf("[WARN] generate_image failed, drawing fallback pattern\n");
-        for (int y = 0; y < YMax; ++y) for (int x = 0; x < XMax; ++x)
-            buf_graf[y*XMax+x] = (x+y)%256;
-    } else {
-        printf("[INFO] generate_image succeeded\n");
+        /* Keep the previous image; only the first has none to keep */
+        printf("[WARN] generate_image failed, %s\n",
+               frame_count ? "keeping the previous image" : "drawing fallback pattern");
+        if (!frame_count)
+            for (int y = 0; y < YMax; ++y) for (int x = 0; x < XMax; ++x)
+                buf_graf[y*XMax+x] = (x+y)%256;
+    } else if (!progressive) {
+        if (gen_stats.polar_built)
+            printf("[INFO] polar cache for %dx%d: %.1f MB, built in %.1f ms\n",
+                   XMax, YMax, gen_stats.polar_bytes / (1024.0 * 1024.0),
+                   gen_stats.polar_build_ms);
+        if (gen_stats.from_cache != IMGCACHE_MISS) {
+            size_t cache_bytes;
+            int cache_entries;
+            imgcache_usage(&cache_bytes, &cache_entries);
+            printf("[INFO] image copied from the %s cache in %.1f ms (%d images, %.1f of %.0f MB)\n",
+                   gen_stats.from_cache == IMGCACHE_DISK ? "disk" : "memory", gen_stats.ms,
+                   cache_entries, cache_bytes / (1024.0 * 1024.0), imgcache_budget / (1024.0 * 1024.0));
+        } else if (gen_stats.polar_cached) {
+            double cost = gen_stats.ms - (gen_stats.polar_built ? gen_stats.polar_build_ms : 0.0);
+            printf("[INFO] generate_image succeeded in %.1f ms (polar cache saved ~%.1f ms, %.1fx)\n",
+                   gen_stats.ms, gen_stats.polar_saved_ms,
+                   (cost + gen_stats.polar_saved_ms) / MAX(cost, 0.1));
+        } else {
+            printf("[INFO] generate_image succeeded in %.1f ms\n", gen_stats.ms);
+        }
     }
     CALL_DEBUG_BUFFER(buf_graf, XMax+1, YMax+1);
-    CALL_DEBUG_PALETTE_INDICES(MainPalArray, buf_graf, 32);
-    convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
-    SDL_UpdateTexture(texture, NULL, pixel_buffer, XMax * sizeof(Uint32));
-    SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+    CALL_DEBUG_PALETTE_INDICES(palring_colors(&MainPal), buf_graf, 32);
+    image_changed = true;
+    presentImage(palring_colors(&MainPal), pixel_buffer);
     frame_count++;
     frames_this_sec++;
     long long now = current_time_ms();
@@ -759,79 +848,83 @@ void main (int argc, char *argv[])
 
     /* create new palette */
     paletteTypeNum = RANDOM(NUM_PALETTE_TYPES +1);
-    initPalArray(TargetPalArray, paletteTypeNum);
-    CALL_DEBUG_PALETTE_RANGE(TargetPalArray, 0, 19);
-    CALL_DEBUG_PALETTE_RANGE(TargetPalArray, 236, 255);
+    initPalArray(palArray, paletteTypeNum);
+    palring_load(&TargetPal, palArray);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&TargetPal), 0, 19);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&TargetPal), 236, 255);
 
     /* this is the fade in */
+    palfade_begin(&fade, &MainPal, FADE_TO_TARGET, &TargetPal);
+    fade_ticks = 0;
+    palClockStart();
     while(!FadeCompleteFlag) {
       handle_sdl_events();
-      if (is_paused) { SDL_Delay(10); continue; }
+      if (is_paused) { SDL_Delay(10); palClockStart(); continue; }
       processinput();
-      if(is_running)
-        rolNFadeMainPalAryToTargNLodDAC(MainPalArray,TargetPalArray);
+      FadeCompleteFlag = palAdvance(&MainPal, &TargetPal, &fade, &fade_ticks);
       if(skip_image)
         break;
-      convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
-      SDL_UpdateTexture(texture, NULL, pixel_buffer, XMax * sizeof(Uint32));
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, NULL, NULL);
-      SDL_RenderPresent(renderer);
-      usleep(ROTATION_DELAY);
+      progressiveTick();
+      panTick();
+      presentImage(palring_colors(&MainPal), pixel_buffer);
+      waitPaletteTick(palring_colors(&MainPal), pixel_buffer);
     }
 
     FadeCompleteFlag=!FadeCompleteFlag;
     ltime = time(NULL);
     mtime = ltime + image_time;
 
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 19);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 236, 255);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 19);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 236, 255);
+
+    /* make the next image while this one rotates; a morphing one
+       keeps the background thread busy until it is over */
+    if (!progressive && !morphing)
+      requestNextImage(imageFuncList, &imageFuncListIndex);
 
     /* rotate the palette for a while */
     for(;;) {
       handle_sdl_events();
-      if (is_paused) { SDL_Delay(10); continue; }
+      if (is_paused) { SDL_Delay(10); palClockStart(); continue; }
       processinput();
-      if(is_running)
-        rollMainPalArrayAndLoadDACRegs(MainPalArray);
+      palAdvance(&MainPal, NULL, NULL, NULL);
       if(skip_image)
         break;
       if(new_palette_requested) {
         newpal();
         new_palette_requested = false;
       }
+      progressiveTick();
+      panTick();
       ltime=time(NULL);
       if((ltime>mtime) && !palette_locked)
         break;
-      convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
-      SDL_UpdateTexture(texture, NULL, pixel_buffer, XMax * sizeof(Uint32));
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, NULL, NULL);
-      SDL_RenderPresent(renderer);
-      usleep(ROTATION_DELAY);
+      presentImage(palring_colors(&MainPal), pixel_buffer);
+      waitPaletteTick(palring_colors(&MainPal), pixel_buffer);
     }
 
-    /* fade out */
+    /* fade out; an image skipped before it was refined stays coarse */
+    gen_progressive_end(&progress);
+    palfade_begin(&fade, &MainPal, fade_dir ? FADE_TO_BLACK : FADE_TO_WHITE, NULL);
+    fade_ticks = 0;
     while(!FadeCompleteFlag) {
       handle_sdl_events();
-      if (is_paused) { SDL_Delay(10); continue; }
+      if (is_paused) { SDL_Delay(10); palClockStart(); continue; }
       processinput();
-      if(is_running)
-        if (fade_dir)
-          rolNFadeBlkMainPalArrayNLoadDAC(MainPalArray);
-        else
-          rolNFadeWhtMainPalArrayNLoadDAC(MainPalArray);
-      convert_8bit_to_32bit(buf_graf, pixel_buffer, XMax, YMax, MainPalArray);
-      SDL_UpdateTexture(texture, NULL, pixel_buffer, XMax * sizeof(Uint32));
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, NULL, NULL);
-      SDL_RenderPresent(renderer);
-      usleep(ROTATION_DELAY);
+      FadeCompleteFlag = palAdvance(&MainPal, NULL, &fade, &fade_ticks);
+      panTick();
+      presentImage(palring_colors(&MainPal), pixel_buffer);
+      waitPaletteTick(palring_colors(&MainPal), pixel_buffer);
     }
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 8);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 0, 19);
-    CALL_DEBUG_PALETTE_RANGE(MainPalArray, 236, 255);
+    if (morphing) {
+      morphStop();
+      requestNextImage(imageFuncList, &imageFuncListIndex);
+    }
+    panStop();
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 8);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 0, 19);
+    CALL_DEBUG_PALETTE_RANGE(palring_colors(&MainPal), 236, 255);
     FadeCompleteFlag=!FadeCompleteFlag;
     skip_image = false;
   }
@@ -898,22 +991,80 @@ void processinput()
     }
 }
 
+/* sdl-indexed draws straight into the window surface, which it takes
+   the size of, so the blit never scales */
+bool indexedinit(Uint32 win_flags)
+{
+  SDL_Surface *screen;
+
+  window = SDL_CreateWindow("Acidwarp", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, XMax, YMax, win_flags);
+  screen = window ? SDL_GetWindowSurface(window) : NULL;
+  if (!screen)
+    return false;
+  XMax = screen->w;
+  YMax = screen->h;
+  /* The surface takes NULL pixels without complaint, so check here */
+  if (!(buf_graf = (uint8_t *)malloc(XMax * YMax)))
+    return false;
+  index_surface = SDL_CreateRGBSurfaceWithFormatFrom(buf_graf, XMax, YMax, 8, XMax, SDL_PIXELFORMAT_INDEX8);
+  if (!index_surface) {
+    free(buf_graf);
+    buf_graf = NULL;
+    return false;
+  }
+  printf("[INFO] sdl-indexed: %dx%d at 1 byte a pixel (%.1f MB, no ARGB buffer or texture of "
+         "our own; SDL's window surface is still 4 bytes a pixel)\n",
+         XMax, YMax, (double)XMax * YMax / (1024.0 * 1024.0));
+  return true;
+}
+
 void graphicsinit(void)
 {
   XMax = window_width;
   YMax = window_height;
-  buf_graf = (uint8_t *)malloc(XMax * YMax); // Store image as 8-bit for algorithm
 
   // SDL2 window/renderer/texture
   SDL_Init(SDL_INIT_VIDEO);
   Uint32 win_flags = 0;
   if (fullscreen) win_flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+  if (renderer_type == RENDERER_SDL_INDEXED) {
+    if (indexedinit(win_flags))
+      return;
+    printf("[WARN] no window surface for --renderer=sdl-indexed, using the SDL renderer\n");
+    renderer_type = RENDERER_SDL;
+    XMax = window_width;
+    YMax = window_height;
+    if (window) SDL_DestroyWindow(window);
+  }
+  buf_graf = (uint8_t *)malloc(XMax * YMax); // Store image as 8-bit for algorithm
+  if (renderer_type == RENDERER_GL_CLASSIC) {
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    window = SDL_CreateWindow("Acidwarp", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, XMax, YMax,
+                              win_flags | SDL_WINDOW_OPENGL);
+    if (window && renderer_gl_classic_init(window))
+      return;
+    printf("[WARN] no OpenGL for --renderer=gl-classic, using the SDL renderer\n");
+    renderer_type = RENDERER_SDL;
+    if (window) SDL_DestroyWindow(window);
+  }
   window = SDL_CreateWindow("Acidwarp", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, XMax, YMax, win_flags);
   renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
   texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, XMax, YMax);
 }
 
 void restoreOldVideoMode(void) {
+  if (frame_prep_count > 0)
+    printf("[INFO] %s: %.3f ms a frame to put the palette on %dx%d (%s, %ld frames)\n",
+           renderer_type == RENDERER_SDL_INDEXED ? "sdl-indexed" : "sdl",
+           frame_prep_ms / frame_prep_count, XMax, YMax,
+           renderer_type == RENDERER_SDL_INDEXED ? "SDL_SetPaletteColors + blit" :
+           "convert_8bit_to_32bit + SDL_UpdateTexture", frame_prep_count);
+  pregen_shutdown();
+  if (pan)
+    pan_shutdown();
+  if (renderer_type == RENDERER_GL_CLASSIC)
+    renderer_gl_classic_cleanup();
+  if (index_surface) SDL_FreeSurface(index_surface);
   if (texture) SDL_DestroyTexture(texture);
   if (renderer) SDL_DestroyRenderer(renderer);
   if (window) SDL_DestroyWindow(window);
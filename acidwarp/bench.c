@@ -0,0 +1,492 @@
+/* acidwarp-bench: times the classic pipeline without opening a window.
+ *
+ * For every resolution and thread count asked for, it times
+ * generate_image() for each pattern, the palette ticks (roll, and roll
+ * with a fade to white, black or a target palette, each with the palette
+ * put together for the screen) and
+ * convert_8bit_to_32bit(). Each figure is the median of --reps runs,
+ * after one untimed run that builds the tables and the polar cache the
+ * way the first image on screen does. The image cache is off, so the
+ * repeatable patterns are really generated every time.
+ *
+ * Results go out as CSV (the default) or JSON. --compare reads a CSV from
+ * an earlier run and flags everything that got slower by more than
+ * --tolerance percent; the exit status is 1 if anything did.
+ *
+ * --morph also times the frames of moving images (see morph.h), one
+ * pattern at a time with the geometry moving on by a 60 Hz frame between
+ * runs, and says which patterns make the MORPH_BUDGET_MS frame budget.
+ *
+ * --verify checks the output itself against golden checksums (see
+ * golden.h) instead of timing anything, and --write-golden records them.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "handy.h"
+#include "acidwarp.h"
+#include "convert.h"
+#include "generate.h"
+#include "golden.h"
+#include "imgcache.h"
+#include "lut.h"
+#include "morph.h"
+#include "palinit.h"
+#include "rolnfade.h"
+#include "userpat.h"
+#include "workpool.h"
+
+#define NUM_PATTERNS   41	/* generate_image() draws 0..40 */
+#define MAX_SIZES      16
+#define MAX_THREADS    16
+#define MAX_PATTERNS   (NUM_PATTERNS + USERPAT_MAX)
+#define PALETTE_TICKS  1000	/* a tick is too short to time on its own */
+#define NAME_LEN       32
+
+/* rolnfade.c's; the player keeps it in acidwarp.c */
+int FadeCompleteFlag = 0;
+
+typedef struct {
+  char   name[NAME_LEN];
+  int    width, height, threads;
+  double ms;			/* per call, or per tick for the palette */
+  double ns_per_pixel;
+} Result;
+
+static Result *results = NULL;
+static int nresults = 0, results_room = 0;
+
+/* What the timed functions work on */
+typedef struct {
+  int       width, height;
+  int       pattern;
+  UCHAR    *buf;
+  uint32_t *rgb;
+  PalRing   pal, target;
+  Morph    *morph;
+} Bench;
+
+typedef void (*bench_fn)(Bench *b);
+
+static double now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  const double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Median time of reps calls, after one untimed call */
+static double measure(bench_fn fn, Bench *b, int reps)
+{
+  double t[64];
+  double start;
+  int i;
+
+  reps = MIN(MAX(reps, 1), (int)(sizeof(t) / sizeof(t[0])));
+  fn(b);
+  for (i = 0; i < reps; ++i)
+    {
+      start = now_ms();
+      fn(b);
+      t[i] = now_ms() - start;
+    }
+  qsort(t, reps, sizeof(t[0]), compare_doubles);
+  return (reps & 1) ? t[reps / 2] : (t[reps / 2 - 1] + t[reps / 2]) / 2;
+}
+
+static void add_result(const char *name, const Bench *b, int threads, double ms)
+{
+  Result *r;
+
+  if (nresults == results_room)
+    {
+      results_room = results_room ? results_room * 2 : 256;
+      results = realloc(results, results_room * sizeof(Result));
+      if (!results)
+	{
+	  fprintf(stderr, "acidwarp-bench: out of memory\n");
+	  exit(1);
+	}
+    }
+  r = &results[nresults++];
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  r->width = b->width;
+  r->height = b->height;
+  r->threads = threads;
+  r->ms = ms;
+  r->ns_per_pixel = ms * 1e6 / ((double)b->width * b->height);
+}
+
+static void run_generate(Bench *b)
+{
+  generate_image(b->pattern, b->buf, b->width / 2, b->height / 2, b->width, b->height, 255);
+}
+
+static void run_morph(Bench *b)
+{
+  GenParams p;
+
+  morph_advance(b->morph, 1000.0 / 60);
+  morph_params(b->morph, &p);
+  generate_frame(&p, b->morph->pc, b->buf);
+}
+
+/* Frame times of the moving version of each pattern that moves */
+static void bench_morph(Bench *b, int threads, const int *patterns, int npatterns, int reps)
+{
+  char name[NAME_LEN];
+  GenParams p;
+  Morph m;
+  double ms;
+  int i;
+
+  for (i = 0; i < npatterns; ++i)
+    {
+      if (!morph_applies(patterns[i]))
+	continue;
+      rng_session_seed(1);
+      gen_draw_params(&p, patterns[i], b->width / 2, b->height / 2, b->width, b->height, 255);
+      morph_begin(&m, &p);
+      b->morph = &m;
+      ms = measure(run_morph, b, reps);
+      morph_end(&m);
+      snprintf(name, sizeof(name), "morph_%d", patterns[i]);
+      add_result(name, b, threads, ms);
+      fprintf(stderr, "[INFO] %s %dx%d %d threads: %.2f ms per frame, %s the %.0f ms budget\n",
+	      name, b->width, b->height, threads, ms,
+	      (ms <= MORPH_BUDGET_MS) ? "within" : "OVER", MORPH_BUDGET_MS);
+    }
+}
+
+static void run_convert(Bench *b)
+{
+  convert_8bit_to_32bit(b->buf, b->rgb, b->width, b->height, palring_colors(&b->pal));
+}
+
+static void run_roll(Bench *b)
+{
+  int i;
+
+  for (i = 0; i < PALETTE_TICKS; ++i)
+    {
+      roll_rgb_palRings(&b->pal, NULL, 1);
+      palring_colors(&b->pal);
+    }
+}
+
+/* A tick at a time, the way the player moves through a fade at its
+   frame rate */
+static void run_fade(Bench *b, FadeKind kind)
+{
+  PalFade fade;
+  int i;
+
+  palfade_begin(&fade, &b->pal, kind, &b->target);
+  for (i = 1; i <= PALETTE_TICKS; ++i)
+    {
+      palfade_seek(&fade, &b->pal, i);
+      roll_rgb_palRings(&b->pal, &b->target, 1);
+      palring_colors(&b->pal);
+    }
+}
+
+static void run_fade_white(Bench *b)
+{
+  run_fade(b, FADE_TO_WHITE);
+}
+
+static void run_fade_black(Bench *b)
+{
+  run_fade(b, FADE_TO_BLACK);
+}
+
+static void run_fade_target(Bench *b)
+{
+  run_fade(b, FADE_TO_TARGET);
+}
+
+static const struct {
+  const char *name;
+  bench_fn    fn;
+} palette_benches[] =
+{
+  { "palette_roll",        run_roll },
+  { "palette_fade_white",  run_fade_white },
+  { "palette_fade_black",  run_fade_black },
+  { "palette_fade_target", run_fade_target },
+};
+
+#define NUM_PALETTE_BENCHES \
+  ((int)(sizeof(palette_benches) / sizeof(palette_benches[0])))
+
+static void bench_size(int width, int height, const int *threads, int nthreads,
+		       const int *patterns, int npatterns, int reps, int morph)
+{
+  Bench b;
+  UCHAR palArray[256 * 3];
+  char name[NAME_LEN];
+  double ms;
+  int t, i;
+
+  memset(&b, 0, sizeof(b));
+  b.width = width;
+  b.height = height;
+  b.buf = malloc((size_t)width * height);
+  b.rgb = malloc((size_t)width * height * sizeof(uint32_t));
+  if (!b.buf || !b.rgb)
+    {
+      fprintf(stderr, "acidwarp-bench: no memory for %dx%d\n", width, height);
+      exit(1);
+    }
+  lut_init(width, height);
+
+  for (t = 0; t < nthreads; ++t)
+    {
+      workpool_init(threads[t]);
+      for (i = 0; i < npatterns; ++i)
+	{
+	  rng_session_seed(1);
+	  b.pattern = patterns[i];
+	  ms = measure(run_generate, &b, reps);
+	  snprintf(name, sizeof(name), "generate_%d", patterns[i]);
+	  add_result(name, &b, threads[t], ms);
+	}
+      if (morph)
+	bench_morph(&b, threads[t], patterns, npatterns, reps);
+
+      /* Through a real picture, so the palette lookups are not all alike */
+      initPalArray(palArray, RGBW_PAL);
+      palring_load(&b.pal, palArray);
+      add_result("convert", &b, threads[t], measure(run_convert, &b, reps));
+    }
+
+  /* The palette work does not depend on the thread count */
+  for (i = 0; i < NUM_PALETTE_BENCHES; ++i)
+    {
+      rng_session_seed(1);
+      initPalArray(palArray, RGBW_PAL);
+      palring_load(&b.pal, palArray);
+      initPalArray(palArray, PASTEL_PAL);
+      palring_load(&b.target, palArray);
+      ms = measure(palette_benches[i].fn, &b, reps) / PALETTE_TICKS;
+      add_result(palette_benches[i].name, &b, 1, ms);
+    }
+
+  free(b.buf);
+  free(b.rgb);
+}
+
+static void write_csv(FILE *f)
+{
+  int i;
+
+  fprintf(f, "name,width,height,threads,ms,ns_per_pixel\n");
+  for (i = 0; i < nresults; ++i)
+    fprintf(f, "%s,%d,%d,%d,%.6f,%.4f\n", results[i].name, results[i].width,
+	    results[i].height, results[i].threads, results[i].ms, results[i].ns_per_pixel);
+}
+
+static void write_json(FILE *f)
+{
+  int i;
+
+  fprintf(f, "[\n");
+  for (i = 0; i < nresults; ++i)
+    fprintf(f, "  {\"name\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, "
+	    "\"ms\": %.6f, \"ns_per_pixel\": %.4f}%s\n", results[i].name, results[i].width,
+	    results[i].height, results[i].threads, results[i].ms, results[i].ns_per_pixel,
+	    (i + 1 < nresults) ? "," : "");
+  fprintf(f, "]\n");
+}
+
+/* Returns the number of regressions, or -1 if the baseline is unreadable */
+static int compare_baseline(const char *path, double tolerance)
+{
+  FILE *f = fopen(path, "r");
+  char line[256];
+  Result old;
+  int i, compared = 0, regressions = 0;
+  double change;
+
+  if (!f)
+    {
+      perror(path);
+      return -1;
+    }
+  while (fgets(line, sizeof(line), f))
+    {
+      if (sscanf(line, "%31[^,],%d,%d,%d,%lf,%lf", old.name, &old.width, &old.height,
+		 &old.threads, &old.ms, &old.ns_per_pixel) != 6)
+	continue;			/* the header */
+      for (i = 0; i < nresults; ++i)
+	if (strcmp(results[i].name, old.name) == 0 && results[i].width == old.width
+	    && results[i].height == old.height && results[i].threads == old.threads)
+	  break;
+      if (i == nresults || old.ns_per_pixel <= 0.0)
+	continue;
+      ++compared;
+      change = (results[i].ns_per_pixel / old.ns_per_pixel - 1.0) * 100.0;
+      if (change > tolerance)
+	{
+	  ++regressions;
+	  fprintf(stderr, "[REGRESSION] %s %dx%d %d threads: %.4f -> %.4f ns/pixel (%+.1f%%)\n",
+		  old.name, old.width, old.height, old.threads,
+		  old.ns_per_pixel, results[i].ns_per_pixel, change);
+	}
+    }
+  fclose(f);
+  fprintf(stderr, "[INFO] Compared %d results with %s: %d slower by more than %.1f%%\n",
+	  compared, path, regressions, tolerance);
+  return regressions;
+}
+
+/* "320x200,1920x1080" */
+static int parse_sizes(const char *s, int *w, int *h)
+{
+  int n = 0, used;
+
+  while (n < MAX_SIZES && sscanf(s, "%dx%d%n", &w[n], &h[n], &used) == 2)
+    {
+      if (w[n] <= 0 || h[n] <= 0)
+	return 0;
+      ++n;
+      s += used;
+      if (*s != ',')
+	break;
+      ++s;
+    }
+  return n;
+}
+
+/* "1,2,8" or, for patterns, "0-40,100" */
+static int parse_list(const char *s, int *list, int room)
+{
+  int n = 0, a, b, used;
+
+  while (sscanf(s, "%d%n", &a, &used) == 1)
+    {
+      s += used;
+      b = a;
+      if (*s == '-' && sscanf(s + 1, "%d%n", &b, &used) == 1)
+	s += 1 + used;
+      for (; a <= b && n < room; ++a)
+	list[n++] = a;
+      if (*s != ',')
+	break;
+      ++s;
+    }
+  return n;
+}
+
+static void usage(const char *argv0)
+{
+  printf("Usage: %s [--sizes WxH,...] [--threads N,...] [--patterns A-B,...] [--reps N]\n"
+	 "       [--format csv|json] [--out FILE] [--compare BASELINE.csv] [--tolerance PCT]\n"
+	 "       [--pattern-file FILE] [--morph]\n"
+	 "       %s --verify GOLDEN | --write-golden GOLDEN\n", argv0, argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  int widths[MAX_SIZES] = { 320, 1280, 1920 };
+  int heights[MAX_SIZES] = { 200, 720, 1080 };
+  int threads[MAX_THREADS];
+  int patterns[MAX_PATTERNS];
+  int nsizes = 3, nthreads = 0, npatterns = NUM_PATTERNS, reps = 5;
+  int json = FALSE, morph = FALSE;
+  const char *out_path = NULL, *baseline = NULL, *pattern_file = NULL;
+  double tolerance = 5.0;
+  FILE *out = stdout;
+  int i, regressions = 0;
+
+  for (i = 0; i < NUM_PATTERNS; ++i)
+    patterns[i] = i;
+  threads[nthreads++] = 1;
+  if (workpool_cpu_count() > 1)
+    threads[nthreads++] = workpool_cpu_count();
+
+  for (i = 1; i < argc; ++i)
+    {
+      if (strcmp(argv[i], "--sizes") == 0 && i+1 < argc)
+	nsizes = parse_sizes(argv[++i], widths, heights);
+      else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+	nthreads = parse_list(argv[++i], threads, MAX_THREADS);
+      else if (strcmp(argv[i], "--patterns") == 0 && i+1 < argc)
+	npatterns = parse_list(argv[++i], patterns, MAX_PATTERNS);
+      else if (strcmp(argv[i], "--reps") == 0 && i+1 < argc)
+	reps = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--format") == 0 && i+1 < argc)
+	json = (strcmp(argv[++i], "json") == 0);
+      else if (strcmp(argv[i], "--out") == 0 && i+1 < argc)
+	out_path = argv[++i];
+      else if (strcmp(argv[i], "--compare") == 0 && i+1 < argc)
+	baseline = argv[++i];
+      else if (strcmp(argv[i], "--tolerance") == 0 && i+1 < argc)
+	tolerance = atof(argv[++i]);
+      else if (strcmp(argv[i], "--pattern-file") == 0 && i+1 < argc)
+	pattern_file = argv[++i];
+      else if (strcmp(argv[i], "--morph") == 0)
+	morph = TRUE;
+      else if (strcmp(argv[i], "--verify") == 0 && i+1 < argc)
+	return (golden_verify(argv[++i]) != 0) ? 1 : 0;
+      else if (strcmp(argv[i], "--write-golden") == 0 && i+1 < argc)
+	return (golden_write(argv[++i]) != 0) ? 1 : 0;
+      else
+	{
+	  usage(argv[0]);
+	  exit(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1);
+	}
+    }
+  if (nsizes == 0 || nthreads == 0 || npatterns == 0)
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+
+  if (pattern_file != NULL)
+    {
+      int loaded = userpat_load(pattern_file);
+      if (loaded < 0)
+	exit(1);
+      for (i = 0; i < loaded && npatterns < MAX_PATTERNS; ++i)
+	patterns[npatterns++] = USERPAT_FIRST + i;
+    }
+
+  imgcache_budget = 0;
+  fprintf(stderr, "[INFO] Span functions use %s, convert %s; median of %d runs\n",
+	  lut_span_isa(), convert_isa(), reps);
+  for (i = 0; i < nsizes; ++i)
+    {
+      fprintf(stderr, "[INFO] %dx%d\n", widths[i], heights[i]);
+      bench_size(widths[i], heights[i], threads, nthreads, patterns, npatterns, reps, morph);
+    }
+  workpool_shutdown();
+
+  if (out_path != NULL && !(out = fopen(out_path, "w")))
+    {
+      perror(out_path);
+      exit(1);
+    }
+  if (json)
+    write_json(out);
+  else
+    write_csv(out);
+  if (out != stdout)
+    fclose(out);
+
+  if (baseline != NULL)
+    regressions = compare_baseline(baseline, tolerance);
+  return (regressions != 0) ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/* Index image to true color, shared by the renderers and acidwarp-bench.
+ *
+ * Only the palette changes from one tick to the next, so it is expanded
+ * once into 256 ready ARGB words and every pixel is then a single table
+ * lookup: 8 at a time with an AVX2 gather, 4 at a time with SSE2 stores,
+ * or one at a time. Frames of 4K and up are split across the worker pool;
+ * one core keeps up with anything smaller, and leaving the pool alone
+ * then keeps it free for the background generator. Frames too big to stay
+ * in the cache are written with non-temporal stores, since they only go on
+ * to the texture upload and would push the source and the table out.
+ */
+#include <stdint.h>
+
+#include "convert.h"
+#include "workpool.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#ifndef DBG_PRINT
+#define DBG_PRINT(...)
+#endif
+
+#define COLOR_CHANNELS 3
+
+#define CONVERT_THREAD_PIXELS (1L << 22)	/* 4K is 8M */
+#define CONVERT_TASK_PIXELS   (1L << 20)	/* at least this many per thread */
+#define CONVERT_STREAM_PIXELS (1L << 20)	/* 4 MB of output and up */
+#define CONVERT_CHUNK_ALIGN   64		/* pixels; tasks start on a cache line */
+
+void convert_palette_to_argb(const uint8_t *palette, uint32_t *argb) {
+    for (int i = 0; i < 256; ++i) {
+        /* Scale 6-bit VGA palette (0-63) to 8-bit (0-255) */
+        uint32_t r = (palette[i * COLOR_CHANNELS + 0] << 2) | (palette[i * COLOR_CHANNELS + 0] >> 4);
+        uint32_t g = (palette[i * COLOR_CHANNELS + 1] << 2) | (palette[i * COLOR_CHANNELS + 1] >> 4);
+        uint32_t b = (palette[i * COLOR_CHANNELS + 2] << 2) | (palette[i * COLOR_CHANNELS + 2] >> 4);
+        argb[i] = (0xFFU << 24) | (r << 16) | (g << 8) | b;
+    }
+}
+
+static void lookup_c(const uint8_t *src, uint32_t *dst, long n, const uint32_t *argb, int stream) {
+    (void)stream;
+    for (long i = 0; i < n; ++i)
+        dst[i] = argb[src[i]];
+}
+
+#ifdef CONVERT_X86
+__attribute__((target("sse2")))
+static void lookup_sse2(const uint8_t *src, uint32_t *dst, long n, const uint32_t *argb, int stream) {
+    long i = 0;
+
+    /* Up to the first 16 byte boundary of dst one at a time */
+    for (; i < n && ((uintptr_t)(dst + i) & 15); ++i)
+        dst[i] = argb[src[i]];
+    if (stream) {
+        for (; i + 4 <= n; i += 4)
+            _mm_stream_si128((__m128i *)(dst + i),
+                             _mm_setr_epi32((int)argb[src[i]], (int)argb[src[i + 1]],
+                                            (int)argb[src[i + 2]], (int)argb[src[i + 3]]));
+        _mm_sfence();
+    } else {
+        for (; i + 4 <= n; i += 4)
+            _mm_store_si128((__m128i *)(dst + i),
+                            _mm_setr_epi32((int)argb[src[i]], (int)argb[src[i + 1]],
+                                           (int)argb[src[i + 2]], (int)argb[src[i + 3]]));
+    }
+    for (; i < n; ++i)
+        dst[i] = argb[src[i]];
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gather8_avx2(const uint8_t *src, const uint32_t *argb) {
+    __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+    return _mm256_i32gather_epi32((const int *)argb, idx, 4);
+}
+
+__attribute__((target("avx2")))
+static void lookup_avx2(const uint8_t *src, uint32_t *dst, long n, const uint32_t *argb, int stream) {
+    long i = 0;
+
+    for (; i < n && ((uintptr_t)(dst + i) & 31); ++i)
+        dst[i] = argb[src[i]];
+    if (stream) {
+        for (; i + 16 <= n; i += 16) {
+            _mm256_stream_si256((__m256i *)(dst + i), gather8_avx2(src + i, argb));
+            _mm256_stream_si256((__m256i *)(dst + i + 8), gather8_avx2(src + i + 8, argb));
+        }
+        _mm_sfence();
+    } else {
+        for (; i + 16 <= n; i += 16) {
+            _mm256_store_si256((__m256i *)(dst + i), gather8_avx2(src + i, argb));
+            _mm256_store_si256((__m256i *)(dst + i + 8), gather8_avx2(src + i + 8, argb));
+        }
+    }
+    for (; i < n; ++i)
+        dst[i] = argb[src[i]];
+}
+#endif /* CONVERT_X86 */
+
+typedef void (*lookup_fn)(const uint8_t *src, uint32_t *dst, long n, const uint32_t *argb, int stream);
+
+static lookup_fn lookup_impl = NULL;
+static const char *lookup_name = "scalar";
+
+/* Pick the widest version the CPU runs, once */
+static lookup_fn lookup_pick(void) {
+    lookup_fn fn = __atomic_load_n(&lookup_impl, __ATOMIC_ACQUIRE);
+
+    if (fn == NULL) {
+        const char *name = "scalar";
+
+        fn = lookup_c;
+#ifdef CONVERT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            fn = lookup_avx2;
+            name = "AVX2";
+        } else if (__builtin_cpu_supports("sse2")) {
+            fn = lookup_sse2;
+            name = "SSE2";
+        }
+#endif
+        lookup_name = name;
+        __atomic_store_n(&lookup_impl, fn, __ATOMIC_RELEASE);
+    }
+    return fn;
+}
+
+const char *convert_isa(void) {
+    lookup_pick();
+    return lookup_name;
+}
+
+void convert_indices(const uint8_t *src, uint32_t *dst, long n, const uint32_t *argb) {
+    lookup_pick()(src, dst, n, argb, n >= CONVERT_STREAM_PIXELS);
+}
+
+typedef struct {
+    const uint8_t *src;
+    uint32_t *dst;
+    long n;
+    int ntasks, stream;
+    const uint32_t *argb;
+    lookup_fn fn;
+} ConvertJob;
+
+static void convert_task(void *ctx, int task) {
+    const ConvertJob *job = (const ConvertJob *)ctx;
+    long chunks = (job->n + CONVERT_CHUNK_ALIGN - 1) / CONVERT_CHUNK_ALIGN;
+    long start = chunks * task / job->ntasks * CONVERT_CHUNK_ALIGN;
+    long end = chunks * (task + 1) / job->ntasks * CONVERT_CHUNK_ALIGN;
+
+    if (end > job->n)
+        end = job->n;
+    job->fn(job->src + start, job->dst + start, end - start, job->argb, job->stream);
+}
+
+void convert_8bit_to_32bit(const uint8_t *src, uint32_t *dst, int width, int height, const uint8_t *palette) {
+    uint32_t argb[256];
+    ConvertJob job;
+    long tasks;
+
+    DBG_PRINT("[DEBUG] Enter convert_8bit_to_32bit\n");
+    DBG_PRINT("[DEBUG] palette[0-8]: %d %d %d %d %d %d %d %d %d\n", palette[0], palette[1], palette[2], palette[3], palette[4], palette[5], palette[6], palette[7], palette[8]);
+    convert_palette_to_argb(palette, argb);
+    job.src = src;
+    job.dst = dst;
+    job.n = (long)width * height;
+    job.argb = argb;
+    job.fn = lookup_pick();
+    job.stream = (job.n >= CONVERT_STREAM_PIXELS);
+    tasks = (job.n >= CONVERT_THREAD_PIXELS) ? job.n / CONVERT_TASK_PIXELS : 1;
+    job.ntasks = (int)((tasks < workpool_size()) ? tasks : workpool_size());
+    if (job.ntasks > 1)
+        workpool_run(convert_task, &job, job.ntasks);
+    else
+        job.fn(src, dst, job.n, argb, job.stream);
+    DBG_PRINT("[DEBUG] Exit convert_8bit_to_32bit\n");
+}
@@ -0,0 +1,18 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stdint.h>
+
+/* Expands an index image through a 6 bit VGA palette (256 RGB triples,
+ * 0-63) to opaque 0xAARRGGBB pixels. Large frames use the worker pool.
+ */
+void convert_8bit_to_32bit(const uint8_t *src, uint32_t *dst, int width, int height, const uint8_t *palette);
+
+/* The two steps of it: the palette as 256 ARGB words, once per tick, and
+ * dst[i] = argb[src[i]] for n pixels on the calling thread.
+ */
+void convert_palette_to_argb(const uint8_t *palette, uint32_t *argb);
+void convert_indices(const uint8_t *src, uint32_t *dst, long n, const uint32_t *argb);
+const char *convert_isa(void);	/* "AVX2", "SSE2" or "scalar" */
+
+#endif // CONVERT_H
@@ -1,6 +1,7 @@
 #include "effects_rgb.h"
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 
 // Helper: HSV to RGB (packed 0xFFRRGGBB)
@@ -22,6 +23,20 @@ static uint32_t hsv2rgb(float h, float s, float v) {
     return (0xFF << 24) | ((int)(r * 255) << 16) | ((int)(g * 255) << 8) | (int)(b * 255);
 }
 
+// Effects that only depend on the distance from the centre (w/2, h/2) are
+// the same at (x, y), (w - x, y) and (x, h - y): dx and dy just change sign.
+// They work out the top left quarter, centre row and column included, and
+// this fills in the rest.
+static void mirror_quarter(uint32_t *buf, int w, int h) {
+    for (int y = 0; y <= h / 2; ++y) {
+        uint32_t *row = buf + y * w;
+        for (int x = w / 2 + 1; x < w; ++x)
+            row[x] = row[w - x];
+    }
+    for (int y = h / 2 + 1; y < h; ++y)
+        memcpy(buf + y * w, buf + (h - y) * w, w * sizeof(uint32_t));
+}
+
 // Plasma effect
 void effect_plasma_rgb(uint32_t *buf, int w, int h, int time_ms) {
     float t = time_ms * 0.0003f;
@@ -70,8 +85,8 @@ void effect_tunnel_rgb(uint32_t *buf, int w, int h, int time_ms) {
 void effect_rings_rgb(uint32_t *buf, int w, int h, int time_ms) {
     float t = time_ms * 0.0004f;
     float cx = w/2.0f, cy = h/2.0f;
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
+    for (int y = 0; y <= h / 2; ++y) {
+        for (int x = 0; x <= w / 2; ++x) {
             float dx = x - cx, dy = y - cy;
             float dist = sqrtf(dx*dx + dy*dy);
             float v = sinf(dist*0.07f + t*2);
@@ -79,6 +94,7 @@ void effect_rings_rgb(uint32_t *buf, int w, int h, int time_ms) {
             buf[y * w + x] = hsv2rgb(hue, 1.0f, 1.0f);
         }
     }
+    mirror_quarter(buf, w, h);
 }
 
 // Checkerboard effect
@@ -166,14 +182,15 @@ void effect_peacock_rgb(uint32_t *buf, int w, int h, int time_ms) {
 void effect_rings_simple_rgb(uint32_t *buf, int w, int h, int time_ms) {
     float t = time_ms * 0.0006f;
     float cx = w / 2.0f, cy = h / 2.0f;
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
+    for (int y = 0; y <= h / 2; ++y) {
+        for (int x = 0; x <= w / 2; ++x) {
             float dx = x - cx, dy = y - cy;
             float dist = sqrtf(dx*dx + dy*dy);
             float hue = fmodf(dist * 0.04f + t, 1.0f);
             buf[y * w + x] = hsv2rgb(hue, 1.0f, 1.0f);
         }
     }
+    mirror_quarter(buf, w, h);
 }
 
 // 2D Wave + Spiral (case 5)
@@ -286,14 +303,15 @@ void effect_2d_wave2_rgb(uint32_t *buf, int w, int h, int time_ms) {
 void effect_rings_concentric_rgb(uint32_t *buf, int w, int h, int time_ms) {
     float t = time_ms * 0.0003f;
     float cx = w / 2.0f, cy = h / 2.0f;
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
+    for (int y = 0; y <= h / 2; ++y) {
+        for (int x = 0; x <= w / 2; ++x) {
             float dx = x - cx, dy = y - cy;
             float dist = sqrtf(dx*dx + dy*dy);
             float hue = fmodf(dist * 0.04f + t, 1.0f);
             buf[y * w + x] = hsv2rgb(hue, 1.0f, 1.0f);
         }
     }
+    mirror_quarter(buf, w, h);
 }
 
 // Simple rays (case 13)
@@ -332,28 +350,30 @@ void effect_spiral_sharp_rgb(uint32_t *buf, int w, int h, int time_ms) {
 void effect_rings_sine_rgb(uint32_t *buf, int w, int h, int time_ms) {
     float t = time_ms * 0.0005f;
     float cx = w / 2.0f, cy = h / 2.0f;
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
+    for (int y = 0; y <= h / 2; ++y) {
+        for (int x = 0; x <= w / 2; ++x) {
             float dx = x - cx, dy = y - cy;
             float dist = sqrtf(dx*dx + dy*dy);
             float hue = 0.5f + 0.5f * sinf(dist * 0.16f + t);
             buf[y * w + x] = hsv2rgb(hue, 1.0f, 1.0f);
         }
     }
+    mirror_quarter(buf, w, h);
 }
 
 // Rings with sine, sliding inner rings (case 16)
 void effect_rings_sine_slide_rgb(uint32_t *buf, int w, int h, int time_ms) {
     float t = time_ms * 0.0005f;
     float cx = w / 2.0f, cy = h / 2.0f;
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
+    for (int y = 0; y <= h / 2; ++y) {
+        for (int x = 0; x <= w / 2; ++x) {
             float dx = x - cx, dy = y - cy;
             float dist = sqrtf(dx*dx + dy*dy);
             float hue = 0.5f + 0.5f * sinf(dist * 0.16f + t + dist * 0.04f);
             buf[y * w + x] = hsv2rgb(hue, 1.0f, 1.0f);
         }
     }
+    mirror_quarter(buf, w, h);
 }
 
 // Nested cos/sin (case 17)
@@ -0,0 +1,1368 @@
+/* Classic image generator (c)Copyright 1992, 1993 by Noah Spurrier
+ * Split out of acidwarp.c so the work can be spread across threads.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "handy.h"
+#include "lut.h"
+#include "generate.h"
+#include "imgcache.h"
+#include "polar.h"
+#include "userpat.h"
+#include "workpool.h"
+
+/* Bands handed out per worker thread; a few per thread evens out the load
+ * between the cheap and expensive parts of a picture.
+ */
+#define BANDS_PER_THREAD 4
+
+__thread GenStats gen_last_stats;
+
+void gen_draw_params(GenParams *p, int imageFuncNum, int xcenter, int ycenter, int xmax, int ymax, int colormax)
+{
+  p->imageFuncNum = imageFuncNum;
+  p->xcenter = xcenter;  p->ycenter = ycenter;
+  p->xmax = xmax;        p->ymax = ymax;
+  p->colormax = colormax;
+
+  p->x1 = RANDOM(40)-20;  p->x2 = RANDOM(40)-20;  p->x3 = RANDOM(40)-20;  p->x4 = RANDOM(40)-20;
+  p->y1 = RANDOM(40)-20;  p->y2 = RANDOM(40)-20;  p->y3 = RANDOM(40)-20;  p->y4 = RANDOM(40)-20;
+  
+  p->a1 = RANDOM(ANGLE_UNIT);  p->a2 = RANDOM(ANGLE_UNIT);  p->a3 = RANDOM(ANGLE_UNIT);  p->a4 = RANDOM(ANGLE_UNIT);
+  
+  rng_split(&rng_session, &p->rng);
+}
+
+/* Per row state handed to the kernels. Distance and angle rows come
+ * straight out of the polar cache when the frame is cached and the centre
+ * offset is within its margin; otherwise they are worked out into one of
+ * the scratch rows. The cache may be built around another centre than the
+ * image's (see generate_frame()), which only adds to the offset.
+ */
+#define ROW_SCRATCH 6
+
+typedef struct {
+  const GenParams *p;
+  const PolarCache *pc;		/* NULL: no cache for this frame */
+  long cox, coy;		/* the image's centre less the cache's */
+  long y, dy;
+  long xstep;			/* 1, or the sample spacing of a coarse pass */
+  long xend;			/* columns wanted, less than xmax when mirrored */
+  long cached_rows;		/* rows read from the cache, for the stats */
+  const int *xwave, *ywave;	/* see wave_vectors() */
+  int nscratch;
+  uint16_t *scratch[ROW_SCRATCH];
+} GenRow;
+
+/* row[x] == lut_dist(x - xcenter + ox, dyrow) */
+static const uint16_t *row_dist(GenRow *r, long ox, long dyrow)
+{
+  const GenParams *p = r->p;
+  const long cx = ox - r->cox, oy = dyrow - r->dy - r->coy;
+  uint16_t *row;
+  long x;
+  
+  if (r->pc && ABS(cx) <= r->pc->margin && ABS(oy) <= r->pc->margin)
+    {
+      ++r->cached_rows;
+      return polar_dist_row(r->pc, r->y, cx, oy);
+    }
+  
+  row = r->scratch[r->nscratch++];
+  if (r->xstep > 1)
+    {
+      for (x = 0; x < r->xend; x += r->xstep)
+        row[x] = (uint16_t)lut_dist (x - p->xcenter + ox, dyrow);
+      return row;
+    }
+  lut_polar_span (ox - p->xcenter, dyrow, (int)r->xend, row, NULL);
+  return row;
+}
+
+/* row[x] == lut_angle(x - xcenter, dyrow) */
+static const uint16_t *row_angle(GenRow *r, long dyrow)
+{
+  const GenParams *p = r->p;
+  const long cx = -r->cox, oy = dyrow - r->dy - r->coy;
+  uint16_t *row;
+  long x;
+  
+  if (r->pc && ABS(cx) <= r->pc->margin && ABS(oy) <= r->pc->margin)
+    {
+      ++r->cached_rows;
+      return polar_angle_row(r->pc, r->y, cx, oy);
+    }
+  
+  row = r->scratch[r->nscratch++];
+  if (r->xstep > 1)
+    {
+      for (x = 0; x < r->xend; x += r->xstep)
+        row[x] = (uint16_t)lut_angle (x - p->xcenter, dyrow);
+      return row;
+    }
+  lut_polar_span (-p->xcenter, dyrow, (int)r->xend, NULL, row);
+  return row;
+}
+
+/* One row kernel per pattern. A kernel writes the raw (unwrapped) color of
+ * every pixel in the row into color[0..xend-1]; terms that only depend on y
+ * are worked out once per row instead of once per pixel. Coarse progressive
+ * passes only want every xstep'th pixel.
+ */
+typedef void (*row_kernel)(GenRow *r, int *color);
+
+#define KERNEL_SETUP(r)							\
+  const GenParams *p = (r)->p;						\
+  const long xmax = (r)->xend, xstep = (r)->xstep;			\
+  const long y = (r)->y, dy = (r)->dy;					\
+  long x;								\
+  (void)p
+
+/* The 2D wave patterns read their column and row terms from the vectors
+ * made by wave_vectors() instead of working out two cosines per pixel.
+ */
+#define WAVE_SETUP(r)							\
+  const int *xwave = (r)->xwave;					\
+  const int ywave = (r)->ywave[y]
+
+/* Full rows of the kernels that are down to adds and divides go
+ * WAVE_BLOCK pixels at a time, since a loop with a fixed count is what
+ * gcc -O2 is willing to vectorize. Coarse passes step as usual.
+ */
+#define WAVE_BLOCK 8
+
+#define WAVE_LOOP(stmt)							\
+  do									\
+    {									\
+      long x0_;								\
+      int i_;								\
+									\
+      if (xstep == 1)							\
+	{								\
+	  for (x0_ = 0; x0_ + WAVE_BLOCK <= xmax; x0_ += WAVE_BLOCK)	\
+	    for (i_ = 0; i_ < WAVE_BLOCK; ++i_)				\
+	      {								\
+		x = x0_ + i_;						\
+		stmt;							\
+	      }								\
+	  for (x = x0_; x < xmax; ++x)					\
+	    stmt;							\
+	}								\
+      else								\
+	for (x = 0; x < xmax; x += xstep)				\
+	  stmt;								\
+    }									\
+  while (0)
+
+/* a / b, b > 0, through double so the loop vectorizes. The operands are
+ * far inside its 53 bits, so the quotient truncates to exactly what the
+ * integer division gives.
+ */
+static inline int wave_div(int a, int b)
+{
+  return (int)((double)a / b);
+}
+
+/* The x and y terms of the 2D wave patterns use the same expression, so
+ * wave_term (n, x, xmax) is a column's and wave_term (n, y, ymax) a row's.
+ * Cases 10, 11 and 22 are nothing but the two terms added up.
+ */
+static int has_waves(int imageFuncNum)
+{
+  switch (imageFuncNum)
+    {
+    case 0:  case 1:  case 5:  case 10: case 11: case 17: case 18:
+    case 19: case 20: case 21: case 22: case 36: case 37:
+      return TRUE;
+    }
+  return FALSE;
+}
+
+static int wave_term(int imageFuncNum, long v, long vmax)
+{
+  switch (imageFuncNum)
+    {
+    case 0:
+      return lut_cos (v * ANGLE_UNIT / vmax * 2) / 32;
+    case 1: case 36: case 37:
+      return lut_cos (v * ANGLE_UNIT / vmax * 2) / 8;
+    case 5: case 11:
+      return lut_cos (v * ANGLE_UNIT / vmax) / 8;
+    case 10:
+      return lut_cos (v * ANGLE_UNIT / vmax * 2) / 4;
+    case 17:
+      return lut_sin (lut_cos (2 * v * ANGLE_UNIT / vmax));
+    case 18:
+      return lut_cos (7 * v * ANGLE_UNIT / vmax);
+    case 19:
+      return lut_cos (17 * v * ANGLE_UNIT / vmax);
+    case 20:
+      return lut_cos (17 * v * ANGLE_UNIT / vmax) / 32;
+    case 21:
+      return lut_cos (7 * v * ANGLE_UNIT / vmax) / 32;
+    case 22:
+      return lut_cos ( 7 * v * ANGLE_UNIT / vmax) / 32 +
+	lut_cos (11 * v * ANGLE_UNIT / vmax) / 32;
+    }
+  return 0;
+}
+
+/* Once per image: the xmax column terms followed by the ymax row terms,
+ * or NULL for patterns without any. -1 when out of memory.
+ */
+static int wave_vectors(const GenParams *p, int **wavesp)
+{
+  int *waves;
+  long v;
+  
+  *wavesp = NULL;
+  if (!has_waves(p->imageFuncNum))
+    return (0);
+  if (!(waves = (int *)malloc((p->xmax + p->ymax) * sizeof(int))))
+    return (-1);
+  for (v = 0; v < p->xmax; ++v)
+    waves[v] = wave_term(p->imageFuncNum, v, p->xmax);
+  for (v = 0; v < p->ymax; ++v)
+    waves[p->xmax + v] = wave_term(p->imageFuncNum, v, p->ymax);
+  *wavesp = waves;
+  return (0);
+}
+
+/* case -1:	Eight Arm Star -- produces weird discontinuity
+   color = dist+ lut_sin(angle * (200 - dist)) / 32;
+*/
+
+static void kernel_0(GenRow *r, int *restrict color)	/* Rays plus 2D Waves */
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + lut_sin (dist[x] * 10) / 64 + xwave[x] + ywave;
+}
+
+static void kernel_1(GenRow *r, int *restrict color)	/* Rays plus 2D Waves */
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + lut_sin (dist[x] * 10) / 16 + xwave[x] + ywave;
+}
+
+static void kernel_2(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *d1 = row_dist(r, p->x1, dy + p->y1);
+  const uint16_t *d2 = row_dist(r, p->x2, dy + p->y2);
+  const uint16_t *d3 = row_dist(r, p->x3, dy + p->y3);
+  const uint16_t *d4 = row_dist(r, p->x4, dy + p->y4);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = lut_sin (d1[x] *  4) / 32 + lut_sin (d2[x] *  8) / 32 +
+      lut_sin (d3[x] * 16) / 32 + lut_sin (d4[x] * 32) / 32;
+}
+
+static void kernel_3(GenRow *r, int *color)	/* Peacock */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *angle = row_angle(r, dy);
+  const uint16_t *right = row_dist(r, 20, dy), *left = row_dist(r, -20, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + lut_sin (right[x] * 10) / 32 +
+      angle[x] + lut_sin (left[x] * 10) / 32;
+}
+
+static void kernel_4(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = lut_sin (dist[x]) / 16;
+}
+
+static void kernel_5(GenRow *r, int *restrict color)	/* 2D Wave + Spiral */
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = xwave[x] + ywave + angle[x] + lut_sin (dist[x]) / 32;
+}
+
+/* Peacock, three centers; cases 6, 7, 8 and 30 only differ in the ring
+ * frequency and how the three waves are combined.
+ */
+#define PEACOCK3_ROWS(r, dy)						\
+  const uint16_t *top = row_dist((r),   0, (dy) - 20);			\
+  const uint16_t *br  = row_dist((r),  20, (dy) + 20);			\
+  const uint16_t *bl  = row_dist((r), -20, (dy) + 20)
+
+#define PEACOCK3(x, k, op)					\
+  (lut_sin (top[x] * (k)) / 32 op				\
+   lut_sin (br[x]  * (k)) / 32 op				\
+   lut_sin (bl[x]  * (k)) / 32)
+
+static void kernel_6(GenRow *r, int *color)	/* Peacock, three centers */
+{
+  KERNEL_SETUP(r);
+  PEACOCK3_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = PEACOCK3(x, 4, +);
+}
+
+static void kernel_7(GenRow *r, int *color)	/* Peacock, three centers */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *angle = row_angle(r, dy);
+  PEACOCK3_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + PEACOCK3(x, 8, +);
+}
+
+static void kernel_8(GenRow *r, int *color)	/* Peacock, three centers */
+{
+  KERNEL_SETUP(r);
+  PEACOCK3_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = PEACOCK3(x, 12, +);
+}
+
+static void kernel_9(GenRow *r, int *color)	/* Five Arm Star */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = dist[x] + lut_sin (5 * angle[x]) / 64;
+}
+
+static void kernel_10(GenRow *r, int *restrict color)	/* 2D Wave */
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  (void)dy;
+  
+  WAVE_LOOP(color[x] = xwave[x] + ywave);
+}
+
+static void kernel_12(GenRow *r, int *color)	/* Simple Concentric Rings */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = dist[x];
+}
+
+static void kernel_13(GenRow *r, int *color)	/* Simple Rays */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *angle = row_angle(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x];
+}
+
+static void kernel_14(GenRow *r, int *color)	/* Toothed Spiral Sharp */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + lut_sin (dist[x] * 8) / 32;
+}
+
+static void kernel_15(GenRow *r, int *color)	/* Rings with sine */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = lut_sin (dist[x] * 4) / 32;
+}
+
+static void kernel_16(GenRow *r, int *color)	/* Rings with sine with sliding inner Rings */
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = dist[x] + lut_sin (dist[x] * 4) / 32;
+}
+
+/* Cases 17 to 19 divide both terms by the distance from the centre */
+static void kernel_17(GenRow *r, int *restrict color)
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy);
+  
+  WAVE_LOOP(color[x] = wave_div (xwave[x], 20 + dist[x]) +
+	    wave_div (ywave, 20 + dist[x]));
+}
+
+static void kernel_20(GenRow *r, int *restrict color)	/* 2D Wave Interference */
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  
+  WAVE_LOOP(color[x] = xwave[x] + ywave + dist[x] + angle[x]);
+}
+
+static void kernel_21(GenRow *r, int *restrict color)	/* 2D Wave Interference */
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy);
+  
+  WAVE_LOOP(color[x] = xwave[x] + ywave + dist[x]);
+}
+
+static void kernel_23(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *angle = row_angle(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = lut_sin (angle[x] * 7) / 32;
+}
+
+/* The four randomly placed centers of cases 24 to 27 */
+#define RING_ROWS(r, dy)					\
+  const uint16_t *d1 = row_dist((r), p->x1, (dy) + p->y1);	\
+  const uint16_t *d2 = row_dist((r), p->x2, (dy) + p->y2);	\
+  const uint16_t *d3 = row_dist((r), p->x3, (dy) + p->y3);	\
+  const uint16_t *d4 = row_dist((r), p->x4, (dy) + p->y4)
+
+#define RING(n, x, k, divisor)	(lut_sin (d##n[x] * (k)) / (divisor))
+
+static void kernel_24(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  RING_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = RING(1, x, 2, 12) + RING(2, x, 4, 12) +
+      RING(3, x, 6, 12) + RING(4, x, 8, 12);
+}
+
+static void kernel_25(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *angle = row_angle(r, dy);
+  RING_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + RING(1, x, 2, 16) +
+      angle[x] + RING(2, x, 4, 16) +
+      RING(3, x, 6, 8) + RING(4, x, 8, 8);
+}
+
+static void kernel_26(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *angle = row_angle(r, dy);
+  RING_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + RING(1, x, 2, 12) +
+      angle[x] + RING(2, x, 4, 12) +
+      angle[x] + RING(3, x, 6, 12) +
+      angle[x] + RING(4, x, 8, 12);
+}
+
+static void kernel_27(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  RING_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = RING(1, x, 2, 32) + RING(2, x, 4, 32) +
+      RING(3, x, 6, 32) + RING(4, x, 8, 32);
+}
+
+static void kernel_30(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  PEACOCK3_ROWS(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = PEACOCK3(x, 4, ^);
+}
+
+static void kernel_31(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = (angle[x] % (ANGLE_UNIT/4)) ^ dist[x];
+}
+
+static void kernel_32(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const long xcenter = p->xcenter;
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = dy ^ (x - xcenter);
+}
+
+/* Cases 35 to 40 average the pattern with a copy squashed vertically */
+static void kernel_35(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  const uint16_t *dist2 = row_dist(r, 0, dy * 2), *angle2 = row_angle(r, dy * 2);
+  long c;
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    {
+      c = angle[x] + lut_sin (dist[x] * 8) / 32;
+      color[x] = (c + angle2[x] + lut_sin (dist2[x] * 8) / 32) / 2;
+    }
+}
+
+static void kernel_36(GenRow *r, int *restrict color)
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  const uint16_t *dist2 = row_dist(r, 0, dy * 2), *angle2 = row_angle(r, dy * 2);
+  long c;
+  
+  for (x = 0; x < xmax; x += xstep)
+    {
+      c = angle[x] + lut_sin (dist[x] * 10) / 16 + xwave[x] + ywave;
+      color[x] = (c + angle2[x] + lut_sin (dist2[x] * 8) / 32) / 2;
+    }
+}
+
+static void kernel_37(GenRow *r, int *restrict color)
+{
+  KERNEL_SETUP(r);
+  WAVE_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  const uint16_t *dist2 = row_dist(r, 0, dy * 2), *angle2 = row_angle(r, dy * 2);
+  long c;
+  
+  for (x = 0; x < xmax; x += xstep)
+    {
+      c = angle[x] + lut_sin (dist[x] * 10) / 16 + xwave[x] + ywave;
+      color[x] = (c + angle2[x] + lut_sin (dist2[x] * 10) / 16 +
+		  xwave[x] + ywave) / 2;
+    }
+}
+
+static void kernel_38(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  /* Every other row is squashed */
+  const long dyrow = (dy % 2) ? dy * 2 : dy;
+  const uint16_t *dist = row_dist(r, 0, dyrow), *angle = row_angle(r, dyrow);
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    color[x] = angle[x] + lut_sin (dist[x] * 8) / 32;
+}
+
+static void kernel_39(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const uint16_t *dist = row_dist(r, 0, dy), *angle = row_angle(r, dy);
+  const uint16_t *dist2 = row_dist(r, 0, dy * 2), *angle2 = row_angle(r, dy * 2);
+  long c;
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    {
+      c = (angle[x] % (ANGLE_UNIT/4)) ^ dist[x];
+      color[x] = (c + ((angle2[x] % (ANGLE_UNIT/4)) ^ dist2[x])) / 2;
+    }
+}
+
+static void kernel_40(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const long xcenter = p->xcenter, dy2 = dy * 2;
+  long dx;
+  (void)y;
+  
+  for (x = 0; x < xmax; x += xstep)
+    {
+      dx = x - xcenter;
+      color[x] = ((dy ^ dx) + (dy2 ^ dx)) / 2;
+    }
+}
+
+/* Patterns from --pattern-file */
+static void kernel_user(GenRow *r, int *color)
+{
+  KERNEL_SETUP(r);
+  const UserPattern *up = userpat_get(p->imageFuncNum);
+  const int uses = userpat_uses(up);
+  const uint16_t *dist = (uses & USERPAT_USES_DIST) ? row_dist(r, 0, dy) : NULL;
+  const uint16_t *angle = (uses & USERPAT_USES_ANGLE) ? row_angle(r, dy) : NULL;
+  (void)x;
+  
+  userpat_row(up, p, y, xmax, xstep, dist, angle, color);
+}
+
+static const row_kernel row_kernels[] =
+{
+  kernel_0,  kernel_1,  kernel_2,  kernel_3,  kernel_4,
+  kernel_5,  kernel_6,  kernel_7,  kernel_8,  kernel_9,
+  kernel_10, kernel_10, kernel_12, kernel_13, kernel_14,
+  kernel_15, kernel_16, kernel_17, kernel_17, kernel_17,
+  kernel_20, kernel_21, kernel_10, kernel_23, kernel_24,
+  kernel_25, kernel_26, kernel_27, NULL,      NULL,	/* 28, 29 rain */
+  kernel_30, kernel_31, kernel_32, NULL,      NULL,	/* 33, 34 rain */
+  kernel_35, kernel_36, kernel_37, kernel_38, kernel_39,
+  kernel_40,
+};
+
+#define NUM_ROW_KERNELS ((int)(sizeof(row_kernels) / sizeof(row_kernels[0])))
+
+static row_kernel kernel_for(int imageFuncNum)
+{
+  if (imageFuncNum >= 0 && imageFuncNum < NUM_ROW_KERNELS)
+    return row_kernels[imageFuncNum];
+  return userpat_get(imageFuncNum) ? kernel_user : NULL;
+}
+
+/* A pattern is local if a pixel does not depend on any other pixel or on
+ * the order pixels are visited in. The rain patterns read their left and
+ * upper neighbours and the default case draws a random number per pixel.
+ */
+int gen_pattern_is_local(int imageFuncNum)
+{
+  return kernel_for(imageFuncNum) != NULL;
+}
+
+/* True if the picture does not depend on the random parameters, so it
+ * comes out the same every time. Cases 2 and 24 to 27 place their centres
+ * at random; the non-local ones draw random numbers per pixel. Loaded
+ * patterns can change from one run to the next under the same number.
+ */
+int gen_pattern_is_repeatable(int imageFuncNum)
+{
+  if (!gen_pattern_is_local(imageFuncNum) || userpat_get(imageFuncNum))
+    return FALSE;
+  switch (imageFuncNum)
+    {
+    case 2: case 24: case 25: case 26: case 27:
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/* Symmetries of a pattern about its centre (xc, yc), exact in integer
+ * arithmetic: lut_dist() only sees |dx| and |dy|, and dy ^ dx is unchanged
+ * when both are complemented. Worked out for every pattern and checked
+ * against full images at odd, even and off-centre sizes; the angle
+ * patterns are out because lut_angle() is not exactly symmetric.
+ */
+#define SYM_MIRROR_X	1	/* (xc + d, y) == (xc - d, y) */
+#define SYM_MIRROR_Y	2	/* (x, yc + d) == (x, yc - d) */
+#define SYM_ROTATE	4	/* (xc + d, yc + e) == (xc - 1 - d, yc - 1 - e) */
+
+static int pattern_symmetry(int imageFuncNum)
+{
+  switch (imageFuncNum)
+    {
+    case 4: case 12: case 15: case 16:		/* rings */
+      return SYM_MIRROR_X | SYM_MIRROR_Y;
+    case 6: case 8: case 30:			/* three centred peacocks */
+      return SYM_MIRROR_X;
+    case 32:
+      return SYM_ROTATE;
+    }
+  return 0;
+}
+
+/* The symmetries this image can use: mirrored columns only if every one
+ * of them has its twin on the screen, and a half turn only if the whole
+ * row does.
+ */
+static int image_symmetry(const GenParams *p)
+{
+  int sym = pattern_symmetry(p->imageFuncNum);
+  
+  if (p->xcenter < 0 || p->xcenter >= p->xmax || 2 * p->xcenter < p->xmax - 1)
+    sym &= ~SYM_MIRROR_X;
+  if (2 * p->xcenter != p->xmax)
+    sym &= ~SYM_ROTATE;
+  return sym;
+}
+
+/* The row that row y is copied to, or -1 */
+static long partner_row(int sym, const GenParams *p, long y)
+{
+  long t;
+  
+  if (sym & SYM_MIRROR_Y)
+    t = 2 * p->ycenter - y;
+  else if (sym & SYM_ROTATE)
+    t = 2 * p->ycenter - 1 - y;
+  else
+    return -1;
+  return (t >= 0 && t < p->ymax) ? t : -1;
+}
+
+/* color % (colormax-1), moved into 0..colormax-2 and then up by one, since
+ * color 0 is never used. The sign fix-up is a mask rather than a branch.
+ */
+static inline UCHAR wrap_color(int color, int modulus)
+{
+  int r = color % modulus;
+  
+  return (UCHAR)(r + (modulus & -(r < 0)) + 1);
+}
+
+static void store_row(const int *color, UCHAR *row, long xmax, int colormax)
+{
+  long x;
+  
+  /* Constant modulus for the usual 256 color palette lets the compiler
+     turn the division into a multiply */
+  if (colormax == 255)
+    for (x = 0; x < xmax; ++x)
+      row[x] = wrap_color(color[x], 254);
+  else
+    for (x = 0; x < xmax; ++x)
+      row[x] = wrap_color(color[x], colormax - 1);
+}
+
+/* A row's colors and its ROW_SCRATCH scratch rows share one block, which
+ * the caller allocates before any work is handed out.
+ */
+static size_t row_scratch_bytes(long xmax)
+{
+  return (size_t)xmax * (sizeof(int) + ROW_SCRATCH * sizeof(uint16_t));
+}
+
+/* Returns the row's colors, at the start of scratch */
+static int *row_init(GenRow *r, const GenParams *p, const PolarCache *pc, const int *waves, void *scratch)
+{
+  uint16_t *rows = (uint16_t *)((int *)scratch + p->xmax);
+  int i;
+  
+  r->p = p;
+  r->pc = pc;
+  r->cox = pc ? p->xcenter - pc->xcenter : 0;
+  r->coy = pc ? p->ycenter - pc->ycenter : 0;
+  r->xwave = waves;
+  r->ywave = waves ? waves + p->xmax : NULL;
+  r->xstep = 1;
+  r->xend = p->xmax;
+  r->cached_rows = 0;
+  for (i = 0; i < ROW_SCRATCH; ++i)
+    r->scratch[i] = rows + i * p->xmax;
+  return (int *)scratch;
+}
+
+static void row_seek(GenRow *r, long y)
+{
+  r->y = y;
+  r->dy = y - r->p->ycenter;
+  r->nscratch = 0;
+}
+
+/* Rows served by the cache are added to *total, which bands share */
+static void row_done(GenRow *r, long *total)
+{
+  __sync_fetch_and_add(total, r->cached_rows);
+}
+
+/* The patterns below are not local: they read back the pixels to their
+ * left and above. They are made in RAIN_TILE square tiles, a diagonal of
+ * tiles at a time, since a tile only needs the tiles to its left and above
+ * it and the tiles on one diagonal are independent of each other. Every
+ * tile draws from its own random stream, so the picture depends on the
+ * seed alone, not on the thread count or the order tiles finish in.
+ */
+#define RAIN_TILE 64
+
+#if GEN_STRIP_ALIGN % RAIN_TILE
+#error "strips must start on a row of rain tiles"
+#endif
+
+typedef struct {
+  const GenParams *p;
+  const PolarCache *pc;
+  UCHAR *buf_graf;		/* row ty0 * RAIN_TILE of the image */
+  uint64_t seed;
+  long tiles_x, tiles_y;	/* tiles_y of them from tile row ty0 */
+  long ty0;
+  long diagonal;		/* tx + ty - ty0 of the tiles being made */
+  long first_tx;		/* of the first of them */
+  long cached_rows;
+} RainJob;
+
+static void rain_tile(void *ctx, int task)
+{
+  RainJob *job = (RainJob *)ctx;
+  const GenParams *p = job->p;
+  const int imageFuncNum = p->imageFuncNum;
+  const int modulus = p->colormax - 1;
+  const long xmax = p->xmax;
+  const long tx = job->first_tx + task, ty = job->ty0 + job->diagonal - tx;
+  const long x0 = tx * RAIN_TILE, x1 = MIN(x0 + RAIN_TILE, xmax);
+  const long y0 = ty * RAIN_TILE, y1 = MIN(y0 + RAIN_TILE, p->ymax);
+  long x, y, color, cached = 0;
+  uint16_t dist[RAIN_TILE];
+  const uint16_t *cached_dist;
+  UCHAR *row, *above;
+  Rng rng;
+  
+  rng_seed(&rng, job->seed, (uint64_t)(ty * job->tiles_x + tx));
+  for (y = y0; y < y1; ++y)
+    {
+      row = job->buf_graf + xmax * (y - job->ty0 * RAIN_TILE);
+      above = row - xmax;
+      if (imageFuncNum == 29)
+	{
+	  if (job->pc)
+	    {
+	      cached_dist = polar_dist_row(job->pc, y, 0, 0);
+	      for (x = x0; x < x1; ++x)
+		dist[x - x0] = cached_dist[x];
+	      cached += (tx == 0);	/* once per image row */
+	    }
+	  else
+	    lut_polar_span (x0 - p->xcenter, y - p->ycenter, (int)(x1 - x0), dist, NULL);
+	}
+      
+      for (x = x0; x < x1; ++x)
+	{
+	  switch (imageFuncNum)
+	    {
+	    case 28:	/* Random Curtain of Rain (in strong wind) */
+	      if (y == 0 || x == 0)
+		color = rng_below (&rng, 16);
+	      else
+		color = (row[x-1] + above[x]) / 2 + rng_below (&rng, 16) - 8;
+	      break;
+	      
+	    case 29:
+	      if (y == 0 || x == 0)
+		color = rng_below (&rng, 1024);
+	      else
+		color = dist[x - x0]/6 + (row[x-1] + above[x]) / 2
+		  + rng_below (&rng, 16) - 8;
+	      break;
+	      
+	    case 33:	/* Variation on Rain */
+	      if (y == 0 || x == 0)
+		color = rng_below (&rng, 16);
+	      else
+		color = (row[x-1] + above[x]) / 2;
+	      
+	      color += rng_below (&rng, 2) - 1;
+	      
+	      if (color < 64)
+		color += rng_below (&rng, 16) - 8;
+	      break; 
+	      
+	    case 34:	/* Variation on Rain */
+	      if (y == 0 || x == 0)
+		color = rng_below (&rng, 16);
+	      else
+		color = (row[x-1] + above[x]) / 2;
+	      
+	      if (color < 100)
+		color += rng_below (&rng, 16) - 8;
+	      break;
+	      
+	    default:
+	      color = rng_below (&rng, modulus) + 1;
+	      break;
+	    }
+	  
+	  /* On the critical path from one pixel to the next, so the usual
+	     modulus is a constant the compiler turns into a multiply */
+	  row[x] = (modulus == 254) ? wrap_color((int)color, 254) : wrap_color((int)color, modulus);
+	}
+    }
+  if (cached)
+    __sync_fetch_and_add(&job->cached_rows, cached);
+}
+
+/* Tile rows ty0 .. ty1-1; buf_graf holds the first of their pixel rows,
+ * with the row above it (if any) just before it.
+ */
+static void generate_rain(const GenParams *p, const PolarCache *pc, UCHAR *buf_graf,
+			  long ty0, long ty1, long *cached_rows)
+{
+  RainJob job;
+  Rng rng = p->rng;
+  long last_tx;
+  
+  job.p = p;
+  job.pc = pc;
+  job.buf_graf = buf_graf;
+  job.seed = (uint64_t)rng_next(&rng) << 32;
+  job.seed |= rng_next(&rng);
+  job.tiles_x = (p->xmax + RAIN_TILE - 1) / RAIN_TILE;
+  job.tiles_y = ty1 - ty0;
+  job.ty0 = ty0;
+  job.cached_rows = 0;
+  for (job.diagonal = 0; job.diagonal < job.tiles_x + job.tiles_y - 1; ++job.diagonal)
+    {
+      job.first_tx = MAX(0, job.diagonal - (job.tiles_y - 1));
+      last_tx = MIN(job.diagonal, job.tiles_x - 1);
+      workpool_run(rain_tile, &job, (int)(last_tx - job.first_tx + 1));
+    }
+  *cached_rows += job.cached_rows;
+}
+
+/* Coarse pass: sample every step'th pixel of the row and fill the
+ * step x step block below and to the right of each sample with it.
+ */
+static void store_blocks(const int *color, UCHAR *buf_graf, long y, long step, const GenParams *p)
+{
+  const long xmax = p->xmax, yend = MIN(y + step, p->ymax);
+  UCHAR *row = buf_graf + xmax * y;
+  long x, yy;
+  
+  for (x = 0; x < xmax; x += step)
+    memset(row + x, wrap_color(color[x], p->colormax - 1), MIN(step, xmax - x));
+  for (yy = y + 1; yy < yend; ++yy)
+    memcpy(buf_graf + xmax * yy, row, xmax);
+}
+
+/* Rows y0, y0+step, ... below y1, split into nbands bands */
+typedef struct {
+  const GenParams *p;
+  const PolarCache *pc;
+  const int *waves;
+  UCHAR *buf_graf;
+  long y0, y1, step;
+  int sym;			/* image_symmetry(), full rows only */
+  int nbands;
+  UCHAR *scratch;		/* row_scratch_bytes() for each band */
+  long cached_rows;
+} BandJob;
+
+/* Fill in what the symmetry gives for free once row y is done: the right
+ * half of the row from the left, and its partner row below it. Partners
+ * come later than their rows, so whichever band makes a row also writes
+ * its copy and nothing else touches it.
+ */
+static void mirror_row(const BandJob *job, long y)
+{
+  const GenParams *p = job->p;
+  const long xmax = p->xmax, x2 = 2 * p->xcenter;
+  UCHAR *row = job->buf_graf + xmax * y, *copy;
+  long x, t;
+  
+  if (job->sym & SYM_MIRROR_X)
+    for (x = p->xcenter + 1; x < xmax; ++x)
+      row[x] = row[x2 - x];
+  
+  if ((t = partner_row(job->sym, p, y)) <= y)
+    return;
+  copy = job->buf_graf + xmax * t;
+  if (job->sym & SYM_ROTATE)
+    for (x = 0; x < xmax; ++x)
+      copy[x] = row[xmax - 1 - x];
+  else
+    memcpy(copy, row, xmax);
+}
+
+static void generate_band(void *ctx, int band)
+{
+  const BandJob *job = (const BandJob *)ctx;
+  const GenParams *p = job->p;
+  const row_kernel kernel = kernel_for(p->imageFuncNum);
+  const long xmax = p->xmax;
+  const long nrows = (job->y1 - job->y0 + job->step - 1) / job->step;
+  long k, y, t, kend = nrows * (band + 1) / job->nbands;
+  int *color;
+  GenRow r;
+  
+  color = row_init(&r, p, job->pc, job->waves, job->scratch + band * row_scratch_bytes(xmax));
+  r.xstep = job->step;
+  if (job->sym & SYM_MIRROR_X)
+    r.xend = p->xcenter + 1;
+  for (k = nrows * band / job->nbands; k < kend; ++k)
+    {
+      y = job->y0 + k * job->step;
+      /* Already copied from the row it mirrors */
+      if (job->sym && (t = partner_row(job->sym, p, y)) >= 0 && t < y)
+	continue;
+      row_seek(&r, y);
+      kernel(&r, color);
+      if (job->step == 1)
+	{
+	  store_row(color, job->buf_graf + xmax * y, r.xend, p->colormax);
+	  if (job->sym)
+	    mirror_row(job, y);
+	}
+      else
+	store_blocks(color, job->buf_graf, y, job->step, p);
+    }
+  row_done(&r, &((BandJob *)job)->cached_rows);
+}
+
+/* -1, with nothing drawn, if the bands' scratch cannot be had */
+static int run_bands(BandJob *job)
+{
+  long nrows = (job->y1 - job->y0 + job->step - 1) / job->step;
+  
+  job->sym = (job->step == 1) ? image_symmetry(job->p) : 0;
+  job->nbands = (int)MIN(nrows, workpool_size() * BANDS_PER_THREAD);
+  job->scratch = (UCHAR *)malloc(job->nbands * row_scratch_bytes(job->p->xmax));
+  if (!job->scratch)
+    return (-1);
+  workpool_run(generate_band, job, job->nbands);
+  free(job->scratch);
+  return (0);
+}
+
+static void polar_stats(GenStats *st, const GenParams *p, const PolarCache *pc, int built, long cached_rows)
+{
+  st->polar_cached = (pc != NULL);
+  st->polar_built = built;
+  st->polar_bytes = pc ? pc->bytes : 0;
+  st->polar_build_ms = pc ? pc->build_ms : 0.0;
+  /* Building the cache worked out two values per cell, so that is
+     roughly what each row read from it would have cost without it */
+  st->polar_saved_ms = pc ?
+    pc->build_ms * cached_rows * p->xmax /
+    (2.0 * pc->stride * (p->ymax + 2 * pc->margin)) : 0.0;
+}
+
+/* Every row of the image, by bands or, for rain, by tiles. -1 when out of
+ * memory, with buf_graf as it was.
+ */
+static int generate_all(const GenParams *p, const PolarCache *pc, UCHAR *buf_graf, long *cached_rows)
+{
+  BandJob job;
+  int *waves, result;
+  
+  if (!gen_pattern_is_local(p->imageFuncNum))
+    {
+      /* Neighbour dependent, so a diagonal of tiles at a time. Rain reads
+         the cache unshifted, so only one built around its own centre. */
+      if (pc && (pc->xcenter != p->xcenter || pc->ycenter != p->ycenter))
+	pc = NULL;
+      generate_rain(p, pc, buf_graf, 0, (p->ymax + RAIN_TILE - 1) / RAIN_TILE, cached_rows);
+      return (0);
+    }
+  
+  if (wave_vectors(p, &waves) != 0)
+    return (-1);
+  job.p = p;
+  job.pc = pc;
+  job.waves = waves;
+  job.buf_graf = buf_graf;
+  job.y0 = 0;
+  job.y1 = p->ymax;
+  job.step = 1;
+  job.cached_rows = 0;
+  result = run_bands(&job);
+  free(waves);
+  *cached_rows += job.cached_rows;
+  return result;
+}
+
+int generate_image_params(const GenParams *p, UCHAR *buf_graf)
+{
+  double start = MSEC_NOW();
+  long cached_rows = 0;
+  int built;
+  const PolarCache *pc;
+  
+  memset(&gen_last_stats, 0, sizeof(gen_last_stats));
+  if ((gen_last_stats.from_cache = imgcache_lookup(p, buf_graf)) != IMGCACHE_MISS)
+    {
+      gen_last_stats.ms = MSEC_NOW() - start;
+      return (0);
+    }
+  
+  pc = polar_cache_acquire(p->xmax, p->ymax, p->xcenter, p->ycenter, &built);
+  if (generate_all(p, pc, buf_graf, &cached_rows) != 0)
+    {
+      polar_cache_release(pc);
+      return (-1);
+    }
+  
+  gen_last_stats.ms = MSEC_NOW() - start;
+  polar_stats(&gen_last_stats, p, pc, built, cached_rows);
+  polar_cache_release(pc);
+  
+  imgcache_store(p, buf_graf);
+  return (0);
+}
+
+int generate_frame(const GenParams *p, const PolarCache *pc, UCHAR *buf_graf)
+{
+  double start = MSEC_NOW();
+  long cached_rows = 0;
+  
+  memset(&gen_last_stats, 0, sizeof(gen_last_stats));
+  if (pc && (pc->xmax != p->xmax || pc->ymax != p->ymax))
+    pc = NULL;
+  if (generate_all(p, pc, buf_graf, &cached_rows) != 0)
+    return (-1);
+  
+  gen_last_stats.ms = MSEC_NOW() - start;
+  polar_stats(&gen_last_stats, p, pc, FALSE, cached_rows);
+  return (0);
+}
+
+/* Tiles of the plane. The kernels see a window onto it whose top left
+ * corner is plane point (x0, y0): the centre moves by the same amount, and
+ * the wave vectors are worked out for the window's columns and rows.
+ * Coarser tiles ask the kernels for every step'th sample, the way a coarse
+ * progressive pass does.
+ */
+int generate_tile(const GenParams *p, long x0, long y0, int step, int size, UCHAR *tile)
+{
+  const row_kernel kernel = kernel_for(p->imageFuncNum);
+  const long span = (long)size * step;
+  const int n = p->imageFuncNum;
+  GenParams q = *p;
+  GenRow r;
+  int *color, *waves = NULL;
+  void *scratch;
+  long i, j, v, cached_rows = 0;
+
+  if (!kernel)
+    {
+      memset(tile, 1, (size_t)size * size);
+      return (0);
+    }
+  /* All of it before the first row, so a failure draws nothing */
+  if (!(scratch = malloc(row_scratch_bytes(span))) ||
+      (has_waves(n) && !(waves = (int *)malloc(2 * span * sizeof(int)))))
+    {
+      free(scratch);
+      return (-1);
+    }
+  if (waves)
+    {
+      for (v = 0; v < span; v += step)
+	{
+	  waves[v] = wave_term(n, x0 + v, p->xmax);
+	  waves[span + v] = wave_term(n, y0 + v, p->ymax);
+	}
+    }
+
+  q.xcenter = p->xcenter - x0;
+  q.ycenter = p->ycenter - y0;
+  q.xmax = q.ymax = span;
+  color = row_init(&r, &q, NULL, waves, scratch);
+  r.xstep = step;
+  for (j = 0; j < size; ++j)
+    {
+      row_seek(&r, j * step);
+      kernel(&r, color);
+      if (step == 1)
+	store_row(color, tile + j * size, size, p->colormax);
+      else
+	for (i = 0; i < size; ++i)
+	  tile[j * size + i] = wrap_color(color[i * step], p->colormax - 1);
+    }
+  row_done(&r, &cached_rows);
+  free(waves);
+  free(scratch);
+  return (0);
+}
+
+/* Strips of an image too large to hold, made without the caches. A local
+ * pattern's strip is just its rows, and only those rows of the row wave
+ * terms are worked out. The rain tiles run from one strip into the next,
+ * so they are made a strip of tile rows at a time on the worker threads.
+ */
+int generate_strip(const GenParams *p, long y0, long rows, UCHAR *strip)
+{
+  const row_kernel kernel = kernel_for(p->imageFuncNum);
+  const int n = p->imageFuncNum;
+  const long xmax = p->xmax, y1 = MIN(y0 + rows, (long)p->ymax);
+  GenRow r;
+  int *color, *waves = NULL;
+  void *scratch;
+  long v, y, cached_rows = 0;
+  
+  if (y0 < 0 || y0 >= y1)
+    return (-1);
+  if (!kernel)
+    {
+      if (y0 % GEN_STRIP_ALIGN || (y1 % GEN_STRIP_ALIGN && y1 != p->ymax))
+	return (-1);
+      generate_rain(p, NULL, strip, y0 / RAIN_TILE, (y1 + RAIN_TILE - 1) / RAIN_TILE, &cached_rows);
+      return (0);
+    }
+  
+  if (!(scratch = malloc(row_scratch_bytes(xmax))) ||
+      (has_waves(n) && !(waves = (int *)malloc((xmax + p->ymax) * sizeof(int)))))
+    {
+      free(scratch);
+      return (-1);
+    }
+  if (waves)
+    {
+      for (v = 0; v < xmax; ++v)
+	waves[v] = wave_term(n, v, xmax);
+      for (v = y0; v < y1; ++v)
+	waves[xmax + v] = wave_term(n, v, p->ymax);
+    }
+  color = row_init(&r, p, NULL, waves, scratch);
+  for (y = y0; y < y1; ++y)
+    {
+      row_seek(&r, y);
+      kernel(&r, color);
+      store_row(color, strip + (y - y0) * xmax, xmax, p->colormax);
+    }
+  row_done(&r, &cached_rows);
+  free(waves);
+  free(scratch);
+  return (0);
+}
+
+/* Progressive generation. The first pass samples an 8 pixel grid, which
+ * takes about 1/64 of the full time, the second a 4 pixel grid, and the
+ * last does every row, a few at a time between palette ticks.
+ */
+static const long progressive_steps[] = { 8, 4, 1 };
+#define NUM_PROGRESSIVE_STEPS ((int)(sizeof(progressive_steps) / sizeof(progressive_steps[0])))
+
+/* Rows of the last pass done per thread between budget checks */
+#define PROGRESSIVE_ROWS_PER_THREAD 8
+
+void gen_progressive_begin(GenProgress *g, const GenParams *p, UCHAR *buf_graf)
+{
+  memset(g, 0, sizeof(*g));
+  g->p = *p;
+  g->buf_graf = buf_graf;
+  g->start = MSEC_NOW();
+  
+  /* Rain, and anything the image cache has, is done in one go */
+  memset(&gen_last_stats, 0, sizeof(gen_last_stats));
+  if (!gen_pattern_is_local(p->imageFuncNum))
+    g->done = TRUE;
+  else if ((gen_last_stats.from_cache = imgcache_lookup(p, buf_graf)) != IMGCACHE_MISS)
+    g->done = TRUE;
+  if (g->done)
+    {
+      if (!gen_last_stats.from_cache)
+	g->failed = (generate_image_params(&g->p, buf_graf) != 0);
+      g->first_ms = g->final_ms = gen_last_stats.ms = MSEC_NOW() - g->start;
+      return;
+    }
+  
+  g->pc = polar_cache_acquire(p->xmax, p->ymax, p->xcenter, p->ycenter, &g->built);
+  if (wave_vectors(p, &g->waves) != 0)
+    {
+      g->failed = TRUE;
+      gen_progressive_end(g);
+      return;
+    }
+  gen_progressive_step(g, 0.0);
+  g->first_ms = MSEC_NOW() - g->start;
+}
+
+int gen_progressive_step(GenProgress *g, double budget_ms)
+{
+  double start = MSEC_NOW();
+  BandJob job;
+  
+  if (g->done)
+    return TRUE;
+  
+  job.p = &g->p;
+  job.pc = g->pc;
+  job.waves = g->waves;
+  job.buf_graf = g->buf_graf;
+  job.cached_rows = 0;
+  do
+    {
+      job.step = progressive_steps[g->pass];
+      job.y0 = g->next_row;
+      job.y1 = g->p.ymax;
+      if (job.step == 1)
+	job.y1 = MIN(job.y1, job.y0 + workpool_size() * PROGRESSIVE_ROWS_PER_THREAD);
+      if (run_bands(&job) != 0)
+	{
+	  /* Out of memory: leave the image as far as it got */
+	  g->failed = TRUE;
+	  gen_progressive_end(g);
+	  return TRUE;
+	}
+      
+      g->next_row = job.y1;
+      if (g->next_row >= g->p.ymax)
+	{
+	  g->next_row = 0;
+	  ++g->pass;
+	}
+    }
+  while (g->pass < NUM_PROGRESSIVE_STEPS && MSEC_NOW() - start < budget_ms);
+  g->cached_rows += job.cached_rows;
+  
+  if (g->pass < NUM_PROGRESSIVE_STEPS)
+    return FALSE;
+  
+  g->final_ms = gen_last_stats.ms = MSEC_NOW() - g->start;
+  g->done = TRUE;
+  polar_stats(&gen_last_stats, &g->p, g->pc, g->built, g->cached_rows);
+  polar_cache_release(g->pc);
+  g->pc = NULL;
+  free(g->waves);
+  g->waves = NULL;
+  imgcache_store(&g->p, g->buf_graf);
+  return TRUE;
+}
+
+/* Drops an unfinished image; harmless after gen_progressive_step() is done */
+void gen_progressive_end(GenProgress *g)
+{
+  polar_cache_release(g->pc);
+  g->pc = NULL;
+  free(g->waves);
+  g->waves = NULL;
+  g->done = TRUE;
+}
+
+int generate_image(int imageFuncNum, UCHAR *buf_graf, int xcenter, int ycenter, int xmax, int ymax, int colormax)
+{
+  GenParams p;
+  
+  gen_draw_params(&p, imageFuncNum, xcenter, ycenter, xmax, ymax, colormax);
+  return generate_image_params(&p, buf_graf);
+}
@@ -0,0 +1,89 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stddef.h>
+
+#include "handy.h"
+
+/* Everything that decides what a classic image looks like. The random
+ * parameters are drawn once per image, before any work is handed out, so a
+ * threaded run produces exactly the same bytes as a single threaded one.
+ */
+typedef struct {
+  int  imageFuncNum;
+  int  xcenter, ycenter, xmax, ymax, colormax;
+  long x1, x2, x3, x4, y1, y2, y3, y4;
+  long a1, a2, a3, a4;
+  Rng  rng;                  /* own stream for the per-pixel random patterns */
+} GenParams;
+
+/* How the last image made on this thread went, for the run statistics */
+typedef struct {
+  double ms;                 /* generation time, polar cache build included */
+  int    polar_cached;       /* read distances and angles from the cache */
+  int    polar_built;        /* the cache was built for this image */
+  size_t polar_bytes;
+  double polar_build_ms;
+  double polar_saved_ms;     /* estimated time the cache saved this image */
+  int    from_cache;         /* IMGCACHE_MEMORY or _DISK: copied, not made */
+} GenStats;
+
+extern __thread GenStats gen_last_stats;
+
+/* A classic image being made a pass at a time, see gen_progressive_begin() */
+typedef struct {
+  GenParams p;
+  UCHAR *buf_graf;
+  const struct PolarCache *pc;
+  int   *waves;
+  int    built;
+  int    pass;
+  long   next_row;             /* in the current pass */
+  long   cached_rows;
+  double start;
+  double first_ms;             /* until the coarse picture was there */
+  double final_ms;             /* until the full resolution one was */
+  int    done;
+  int    failed;               /* out of memory; done, the image as far as it got */
+} GenProgress;
+
+void gen_draw_params(GenParams *p, int imageFuncNum, int xcenter, int ycenter, int xmax, int ymax, int colormax);
+int  gen_pattern_is_local(int imageFuncNum);
+int  gen_pattern_is_repeatable(int imageFuncNum);
+/* 0, or -1 when out of memory, with buf_graf left as it was */
+int  generate_image_params(const GenParams *p, UCHAR *buf_graf);
+/* One frame of a moving image (--morph): past the image cache, since
+ * frames do not come back, and reading the caller's polar cache instead of
+ * acquiring one. That cache may be built around another centre than p's;
+ * rows further off it than its margin are worked out as without a cache.
+ */
+int  generate_frame(const GenParams *p, const struct PolarCache *pc, UCHAR *buf_graf);
+/* One size x size tile of the unbounded plane the local patterns are
+ * defined on, for pan mode: samples step plane units apart from plane
+ * point (x0, y0), where the image p describes has its top left corner at
+ * (0, 0). Made on the calling thread alone and without the caches, so any
+ * number of threads can make tiles at once. Loaded patterns are out, since
+ * their x and y would be the tile's. 0, or -1 with nothing drawn when out
+ * of memory.
+ */
+int  generate_tile(const GenParams *p, long x0, long y0, int step, int size, UCHAR *tile);
+/* Rows y0 .. y0+rows-1 of the image p describes, for images too large to
+ * hold whole (see poster.c). Local patterns are made on the calling thread
+ * alone, so several strips can be made at once. The others use the worker
+ * threads and read the row above the strip from strip[-xmax], so their
+ * strips are made in order, start on a multiple of GEN_STRIP_ALIGN rows
+ * and are a multiple of it high unless they end the image. 0, or -1 for
+ * a strip that breaks those rules or when out of memory.
+ */
+#define GEN_STRIP_ALIGN 64
+int  generate_strip(const GenParams *p, long y0, long rows, UCHAR *strip);
+/* Runs the coarse first pass; gen_progressive_step() refines for about
+ * budget_ms at a time and returns TRUE once the image is complete, or once
+ * it has stopped for want of memory with failed set.
+ */
+void gen_progressive_begin(GenProgress *g, const GenParams *p, UCHAR *buf_graf);
+int  gen_progressive_step(GenProgress *g, double budget_ms);
+void gen_progressive_end(GenProgress *g);
+int  generate_image(int imageFuncNum, UCHAR *buf_graf, int xcenter, int ycenter, int xmax, int ymax, int colormax);
+
+#endif // GENERATE_H
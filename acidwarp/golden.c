@@ -0,0 +1,298 @@
+/* Golden checksums for the classic pipeline, see golden.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "handy.h"
+#include "acidwarp.h"
+#include "generate.h"
+#include "golden.h"
+#include "imgcache.h"
+#include "lut.h"
+#include "palinit.h"
+#include "polar.h"
+#include "rolnfade.h"
+#include "workpool.h"
+
+#define GOLDEN_SEED     1992
+#define GOLDEN_PATTERNS 41	/* generate_image() draws 0..40 */
+#define GOLDEN_TICKS    256
+#define GOLDEN_KEY      48
+#define GOLDEN_THREADS  4	/* enough bands to interleave even on one CPU */
+
+/* Even and odd sizes, and one past 2048 for the finer distance frame */
+static const struct { int width, height; } golden_sizes[] =
+{
+  { 320, 200 }, { 641, 401 }, { 1280, 720 }, { 2560, 1440 },
+};
+#define NUM_GOLDEN_SIZES ((int)(sizeof(golden_sizes) / sizeof(golden_sizes[0])))
+
+/* The ways an image can be made. PATH_PLAIN is the reference. */
+enum { PATH_PLAIN, PATH_POLAR, PATH_THREADS, PATH_PROGRESSIVE, PATH_IMGCACHE, NUM_PATHS };
+
+static const char *const path_names[NUM_PATHS] =
+{
+  "plain", "polar cache", "threads", "progressive", "image cache",
+};
+
+/* rolnfade.c's roll directions, reset so every run starts alike, and the
+   flag its per-tick fades raise */
+extern int RedRollDirection, GrnRollDirection, BluRollDirection;
+extern int FadeCompleteFlag;
+
+typedef struct {
+  char     key[GOLDEN_KEY];
+  uint64_t sum;
+} Checksum;
+
+/* FNV-1a, 64 bit */
+#define FNV_OFFSET  0xcbf29ce484222325ULL
+#define FNV_PRIME   0x100000001b3ULL
+
+static uint64_t fnv1a(const UCHAR *data, size_t len, uint64_t h)
+{
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+    h = (h ^ data[i]) * FNV_PRIME;
+  return h;
+}
+
+static void use_path(int path)
+{
+  polar_cache_enabled = (path != PATH_PLAIN);
+  imgcache_budget = (path == PATH_IMGCACHE) ? (size_t)256 * 1024 * 1024 : 0;
+  workpool_init((path == PATH_PLAIN || path == PATH_POLAR) ? 1 : GOLDEN_THREADS);
+}
+
+static uint64_t image_sum(int path, int imageFuncNum, int width, int height, UCHAR *buf)
+{
+  GenParams p;
+  GenProgress g;
+
+  rng_session_seed(GOLDEN_SEED + imageFuncNum);
+  gen_draw_params(&p, imageFuncNum, width / 2, height / 2, width, height, 255);
+  memset(buf, 0, (size_t)width * height);
+  switch (path)
+    {
+    case PATH_PROGRESSIVE:
+      gen_progressive_begin(&g, &p, buf);
+      while (!gen_progressive_step(&g, 1.0))
+	;
+      gen_progressive_end(&g);
+      break;
+    case PATH_IMGCACHE:
+      /* The second one comes out of the cache if the pattern is repeatable */
+      generate_image_params(&p, buf);
+      memset(buf, 0, (size_t)width * height);
+      generate_image_params(&p, buf);
+      break;
+    default:
+      generate_image_params(&p, buf);
+      break;
+    }
+  return fnv1a(buf, (size_t)width * height, FNV_OFFSET);
+}
+
+/* A palette type and GOLDEN_TICKS ticks of rolling and fading it towards
+ * the next type. The player moves palettes by elapsed ticks
+ * (roll_rgb_palRings(), palfade_seek()); the web player still goes a tick
+ * at a time through the rolNFade...() calls. Both must give the same sum.
+ */
+static uint64_t palette_sum(int palType, int per_tick)
+{
+  UCHAR palArray[256 * 3];
+  PalRing pal, target;
+  PalFade fade;
+  uint64_t h;
+  int tick;
+
+  rng_session_seed(GOLDEN_SEED + 1000 + palType);
+  RedRollDirection = GrnRollDirection = BluRollDirection = 0;
+  FadeCompleteFlag = 0;
+  initPalArray(palArray, palType);
+  palring_load(&pal, palArray);
+  initPalArray(palArray, (palType + 1) % NUM_PALETTE_TYPES);
+  palring_load(&target, palArray);
+  palfade_begin(&fade, &pal, FADE_TO_TARGET, &target);
+  h = fnv1a(palring_colors(&pal), sizeof(palArray), FNV_OFFSET);
+  for (tick = 0; tick < GOLDEN_TICKS; ++tick)
+    {
+      if (per_tick)
+	rolNFadeMainPalAryToTargNLodDAC(&pal, &target);
+      else
+	{
+	  roll_rgb_palRings(&pal, &target, 1);
+	  palfade_seek(&fade, &pal, tick + 1);
+	}
+      h = fnv1a(palring_colors(&pal), sizeof(palArray), h);
+    }
+  FadeCompleteFlag = 0;
+  return h;
+}
+
+static Checksum *read_golden(const char *path, int *count)
+{
+  FILE *f = fopen(path, "r");
+  char line[128];
+  char *space;
+  Checksum *sums = NULL, *more;
+  size_t len;
+  int n = 0, room = 0;
+
+  if (!f)
+    {
+      perror(path);
+      return NULL;
+    }
+  while (fgets(line, sizeof(line), f))
+    {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (line[0] == '#' || line[0] == '\0' || !(space = strrchr(line, ' ')))
+	continue;
+      *space = '\0';
+      if ((len = strlen(line)) >= sizeof(sums[n].key))
+	{
+	  fprintf(stderr, "%s: key too long, skipped: %s\n", path, line);
+	  continue;
+	}
+      if (n == room)
+	{
+	  room = room ? room * 2 : 512;
+	  if (!(more = realloc(sums, room * sizeof(Checksum))))
+	    {
+	      fprintf(stderr, "%s: out of memory\n", path);
+	      free(sums);
+	      fclose(f);
+	      return NULL;
+	    }
+	  sums = more;
+	}
+      memcpy(sums[n].key, line, len + 1);
+      sums[n].sum = strtoull(space + 1, NULL, 16);
+      ++n;
+    }
+  fclose(f);
+  *count = n;
+  return sums;
+}
+
+static const Checksum *find_sum(const Checksum *sums, int n, const char *key)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (strcmp(sums[i].key, key) == 0)
+      return &sums[i];
+  return NULL;
+}
+
+/* Writes (f != NULL) or checks against sums every checksum along the
+ * given paths. Returns the number of mismatches.
+ */
+static int run_golden(FILE *f, const Checksum *sums, int nsums, int npaths)
+{
+  char key[GOLDEN_KEY];
+  const Checksum *want;
+  uint64_t got, got2;
+  UCHAR *buf;
+  int size, path, n, mismatches = 0;
+
+  /* The pictures depend on the tables lutgen.c made for it */
+  if (f)
+    fprintf(f, "angle_unit %016x\n", ANGLE_UNIT);
+  else if (!(want = find_sum(sums, nsums, "angle_unit")))
+    {
+      fprintf(stderr, "[MISMATCH] angle_unit: built for %d, the file does not say\n", ANGLE_UNIT);
+      ++mismatches;
+    }
+  else if (want->sum != ANGLE_UNIT)
+    {
+      fprintf(stderr, "[MISMATCH] angle_unit: built for %d, the checksums are for %d\n",
+	      ANGLE_UNIT, (int)want->sum);
+      ++mismatches;
+    }
+
+  for (n = 0; n < NUM_PALETTE_TYPES; ++n)
+    {
+      snprintf(key, sizeof(key), "palette %d", n);
+      got = palette_sum(n, FALSE);
+      if (f)
+	fprintf(f, "%s %016llx\n", key, (unsigned long long)got);
+      else if (!(want = find_sum(sums, nsums, key)) || want->sum != got)
+	{
+	  fprintf(stderr, "[MISMATCH] %s: %016llx\n", key, (unsigned long long)got);
+	  ++mismatches;
+	}
+      /* Not recorded apart: the per-tick calls must match the same sum */
+      if ((got2 = palette_sum(n, TRUE)) != got)
+	{
+	  fprintf(stderr, "[MISMATCH] %s, a tick at a time: %016llx\n", key, (unsigned long long)got2);
+	  ++mismatches;
+	}
+    }
+
+  for (size = 0; size < NUM_GOLDEN_SIZES; ++size)
+    {
+      const int width = golden_sizes[size].width, height = golden_sizes[size].height;
+
+      buf = malloc((size_t)width * height);
+      if (!buf)
+	return ++mismatches;
+      lut_init(width, height);
+      for (path = 0; path < npaths; ++path)
+	{
+	  use_path(path);
+	  for (n = 0; n < GOLDEN_PATTERNS; ++n)
+	    {
+	      snprintf(key, sizeof(key), "image %d %dx%d", n, width, height);
+	      got = image_sum(path, n, width, height, buf);
+	      if (f)
+		fprintf(f, "%s %016llx\n", key, (unsigned long long)got);
+	      else if (!(want = find_sum(sums, nsums, key)) || want->sum != got)
+		{
+		  fprintf(stderr, "[MISMATCH] %s (%s): %016llx\n",
+			  key, path_names[path], (unsigned long long)got);
+		  ++mismatches;
+		}
+	    }
+	}
+      free(buf);
+    }
+
+  use_path(PATH_PLAIN);
+  polar_cache_enabled = TRUE;
+  return mismatches;
+}
+
+int golden_write(const char *path)
+{
+  FILE *f = fopen(path, "w");
+
+  if (!f)
+    {
+      perror(path);
+      return -1;
+    }
+  fprintf(f, "# Classic pipeline checksums (FNV-1a 64), from acidwarp-bench --write-golden.\n"
+	  "# Regenerate only when a change to the pictures or palettes is intended.\n");
+  run_golden(f, NULL, 0, 1);
+  fclose(f);
+  printf("[INFO] Wrote golden checksums to %s\n", path);
+  return 0;
+}
+
+int golden_verify(const char *path)
+{
+  Checksum *sums;
+  int nsums = 0, mismatches;
+
+  if (!(sums = read_golden(path, &nsums)))
+    return -1;
+  mismatches = run_golden(NULL, sums, nsums, NUM_PATHS);
+  printf("[INFO] %d checksums from %s, %d paths: %d mismatches\n",
+	 nsums, path, NUM_PATHS, mismatches);
+  free(sums);
+  return mismatches;
+}
@@ -0,0 +1,21 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+/* Checksums of what the classic pipeline produces from a fixed seed: every
+ * pattern at a few resolutions, and the palettes through a run of ticks.
+ * golden_write() records them from the plainest path (one thread, no
+ * caches); golden_verify() recomputes them along every faster path the
+ * player can take and reports each one that differs.
+ *
+ * The batch versions of lut_dist() and lut_angle() are held to the same
+ * standard: the plain path reads them row by row (lut_polar_span()), the
+ * cached ones through the polar cache built with them, and the big size
+ * uses the finer frame. They must match the scalar functions exactly.
+ *
+ * Returns the number of mismatches, 0 after writing, or -1 if the file
+ * could not be read or written.
+ */
+int golden_write(const char *path);
+int golden_verify(const char *path);
+
+#endif // GOLDEN_H
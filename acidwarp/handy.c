@@ -0,0 +1,14 @@
+/* The parts of "handy.h" that need more than C99 */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+
+#include "handy.h"
+
+/* Monotonic, so setting the clock never stalls or races the palette */
+double MSEC_NOW(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
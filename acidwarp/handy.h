@@ -18,14 +18,19 @@ typedef enum {FALSE, TRUE} BOOL;
 #include <time.h>
 #include <stdio.h> /* Needed for NULL * */
 #include <stdlib.h>
-#define RANDOMIZE() (srand((UINT)time( (time_t *)NULL )))
-#define RANDOM(a) (rand()%(a))
+#include "rng.h"
+#define RANDOMIZE() (rng_session_seed((uint64_t)time( (time_t *)NULL )))
+#define RANDOM(a) (rng_below(&rng_session, (a)))
 
 /* Mini-benchmarking tools. Only one second accuracy */
 extern time_t __HANDY_BENCH;
 #define START() (__HANDY_BENCH = time (&__HANDY_BENCH))
 #define MARK()  ((long)time ((time_t *)0) - __HANDY_BENCH)
 
+/* Millisecond timer for when one second is not good enough. Counts from
+   an arbitrary point, so only differences between readings mean anything. */
+double MSEC_NOW(void);
+
 /* Stuff that's already there, but is faster as a MACRO */
 #define MIN(a,b)  (((a) < (b)) ?  (a) : (b) )
 #define MAX(a,b)  (((a) > (b)) ?  (a) : (b) )
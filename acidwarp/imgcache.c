@@ -0,0 +1,261 @@
+/* LRU cache of generated index images, see "imgcache.h". */
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "handy.h"
+#include "generate.h"
+#include "imgcache.h"
+#include "lut.h"
+
+/* Bump whenever a change to the generator changes its output, so stale
+ * files on disk are not picked up. Builds for another ANGLE_UNIT draw
+ * other pictures too, so the unit is part of the key as well.
+ */
+#define IMGCACHE_VERSION 3
+#define IMGCACHE_MAGIC   "AWINDEX"
+
+typedef struct {
+  int func, xmax, ymax, xcenter, ycenter, colormax, angle_unit;
+} ImgKey;
+
+/* On disk the image follows this header, padded to 64 bytes */
+typedef struct {
+  char    magic[8];
+  int32_t version;
+  int32_t func, xmax, ymax, xcenter, ycenter, colormax, angle_unit;
+  char    pad[24];
+} ImgFileHeader;
+
+typedef struct ImgEntry {
+  ImgKey key;
+  const UCHAR *data;
+  size_t bytes;
+  void  *map;			/* mmap()ed file the data sits in, or NULL */
+  size_t map_bytes;
+  struct ImgEntry *next;
+} ImgEntry;
+
+size_t      imgcache_budget = 64L * 1024 * 1024;
+const char *imgcache_dir = NULL;
+
+static ImgEntry *cache_list = NULL;	/* most recently used first */
+static size_t cache_bytes = 0;
+static int cache_entries = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void make_key(ImgKey *key, const GenParams *p)
+{
+  key->func = p->imageFuncNum;
+  key->xmax = p->xmax;          key->ymax = p->ymax;
+  key->xcenter = p->xcenter;    key->ycenter = p->ycenter;
+  key->colormax = p->colormax;
+  key->angle_unit = ANGLE_UNIT;
+}
+
+static int same_key(const ImgKey *a, const ImgKey *b)
+{
+  return a->func == b->func && a->xmax == b->xmax && a->ymax == b->ymax &&
+    a->xcenter == b->xcenter && a->ycenter == b->ycenter &&
+    a->colormax == b->colormax && a->angle_unit == b->angle_unit;
+}
+
+static void free_entry(ImgEntry *e)
+{
+  if (e->map)
+    munmap(e->map, e->map_bytes);
+  else
+    free((void *)e->data);
+  free(e);
+}
+
+/* Drop the least recently used entries until the budget is met */
+static void trim_cache(void)
+{
+  ImgEntry **link, *e;
+
+  while (cache_bytes > imgcache_budget && cache_list)
+    {
+      for (link = &cache_list; (*link)->next; link = &(*link)->next)
+        ;
+      e = *link;
+      *link = NULL;
+      cache_bytes -= e->bytes;
+      --cache_entries;
+      free_entry(e);
+    }
+}
+
+static void add_entry(ImgEntry *e)
+{
+  e->next = cache_list;
+  cache_list = e;
+  cache_bytes += e->bytes;
+  ++cache_entries;
+  trim_cache();
+}
+
+static void file_name(char *name, size_t size, const ImgKey *key)
+{
+  snprintf(name, size, "%s/f%02d-%dx%d-c%d,%d-m%d-a%d-v%d.idx", imgcache_dir,
+           key->func, key->xmax, key->ymax, key->xcenter, key->ycenter,
+           key->colormax, key->angle_unit, IMGCACHE_VERSION);
+}
+
+/* Maps a file written by write_file() back in; NULL if missing or stale */
+static ImgEntry *map_file(const ImgKey *key)
+{
+  char name[1024];
+  struct stat st;
+  const ImgFileHeader *h;
+  ImgEntry *e;
+  size_t bytes = (size_t)key->xmax * key->ymax;
+  void *map;
+  int fd;
+
+  file_name(name, sizeof(name), key);
+  if ((fd = open(name, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size != sizeof(ImgFileHeader) + bytes)
+    {
+      close(fd);
+      return NULL;
+    }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  h = (const ImgFileHeader *)map;
+  if (memcmp(h->magic, IMGCACHE_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != IMGCACHE_VERSION || h->func != key->func ||
+      h->xmax != key->xmax || h->ymax != key->ymax ||
+      h->xcenter != key->xcenter || h->ycenter != key->ycenter ||
+      h->colormax != key->colormax || h->angle_unit != key->angle_unit ||
+      !(e = (ImgEntry *)calloc(1, sizeof(ImgEntry))))
+    {
+      munmap(map, st.st_size);
+      return NULL;
+    }
+  e->key = *key;
+  e->data = (const UCHAR *)map + sizeof(ImgFileHeader);
+  e->bytes = bytes;
+  e->map = map;
+  e->map_bytes = st.st_size;
+  return e;
+}
+
+/* Written under a temporary name and renamed, so a reader never sees half
+ * a file.
+ */
+static void write_file(const ImgKey *key, const UCHAR *buf)
+{
+  char name[1024], tmp[1100];
+  ImgFileHeader h;
+  size_t bytes = (size_t)key->xmax * key->ymax;
+  FILE *f;
+  int ok;
+
+  mkdir(imgcache_dir, 0755);
+  file_name(name, sizeof(name), key);
+  snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", name, (long)getpid());
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, IMGCACHE_MAGIC, sizeof(h.magic));
+  h.version = IMGCACHE_VERSION;
+  h.func = key->func;
+  h.xmax = key->xmax;        h.ymax = key->ymax;
+  h.xcenter = key->xcenter;  h.ycenter = key->ycenter;
+  h.colormax = key->colormax;
+  h.angle_unit = key->angle_unit;
+
+  if (!(f = fopen(tmp, "wb")))
+    return;
+  ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(buf, 1, bytes, f) == bytes;
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp, name) != 0)
+    remove(tmp);
+}
+
+int imgcache_lookup(const GenParams *p, UCHAR *buf)
+{
+  ImgKey key;
+  ImgEntry **link, *e;
+  int found = IMGCACHE_MISS;
+
+  if (!gen_pattern_is_repeatable(p->imageFuncNum))
+    return IMGCACHE_MISS;
+  make_key(&key, p);
+
+  pthread_mutex_lock(&cache_lock);
+  for (link = &cache_list; (e = *link) != NULL; link = &e->next)
+    if (same_key(&e->key, &key))
+      {
+        *link = e->next;	/* back in at the front below */
+        e->next = cache_list;
+        cache_list = e;
+        found = IMGCACHE_MEMORY;
+        break;
+      }
+
+  if (!e && imgcache_dir && (e = map_file(&key)) != NULL)
+    {
+      found = IMGCACHE_DISK;
+      memcpy(buf, e->data, e->bytes);
+      add_entry(e);
+    }
+  else if (e)
+    memcpy(buf, e->data, e->bytes);
+  pthread_mutex_unlock(&cache_lock);
+  return found;
+}
+
+void imgcache_store(const GenParams *p, const UCHAR *buf)
+{
+  ImgKey key;
+  ImgEntry *e, *dup;
+  size_t bytes = (size_t)p->xmax * p->ymax;
+
+  if (!gen_pattern_is_repeatable(p->imageFuncNum))
+    return;
+  make_key(&key, p);
+
+  /* Only called after a miss, so the file is not there either */
+  if (imgcache_dir)
+    write_file(&key, buf);
+
+  if (bytes > imgcache_budget || !(e = (ImgEntry *)calloc(1, sizeof(ImgEntry))))
+    return;
+  if (!(e->data = (const UCHAR *)malloc(bytes)))
+    {
+      free(e);
+      return;
+    }
+  memcpy((UCHAR *)e->data, buf, bytes);
+  e->key = key;
+  e->bytes = bytes;
+
+  pthread_mutex_lock(&cache_lock);
+  for (dup = cache_list; dup && !same_key(&dup->key, &key); dup = dup->next)
+    ;
+  if (dup)
+    free_entry(e);		/* another thread got there first */
+  else
+    add_entry(e);
+  pthread_mutex_unlock(&cache_lock);
+}
+
+void imgcache_usage(size_t *bytes, int *entries)
+{
+  pthread_mutex_lock(&cache_lock);
+  *bytes = cache_bytes;
+  *entries = cache_entries;
+  pthread_mutex_unlock(&cache_lock);
+}
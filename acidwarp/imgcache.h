@@ -0,0 +1,28 @@
+#ifndef IMGCACHE_H
+#define IMGCACHE_H
+
+#include <stddef.h>
+
+#include "handy.h"
+#include "generate.h"
+
+/* Finished index images of the repeatable patterns (see
+ * gen_pattern_is_repeatable()), kept so a pattern that comes round again in
+ * the shuffled list is copied instead of generated. Entries are keyed on
+ * everything the picture depends on: pattern, resolution, centre and color
+ * count. The least recently used go first once imgcache_budget is reached.
+ *
+ * With imgcache_dir set, images are also written there and mapped back in
+ * on a miss, so they survive to the next launch.
+ */
+enum { IMGCACHE_MISS, IMGCACHE_MEMORY, IMGCACHE_DISK };
+
+extern size_t      imgcache_budget;   /* bytes; 0 turns the memory cache off */
+extern const char *imgcache_dir;      /* NULL: no disk store */
+
+/* Fills buf and returns where it came from, or IMGCACHE_MISS */
+int  imgcache_lookup(const GenParams *p, UCHAR *buf);
+void imgcache_store(const GenParams *p, const UCHAR *buf);
+void imgcache_usage(size_t *bytes, int *entries);
+
+#endif // IMGCACHE_H
@@ -1,8 +1,18 @@
 #ifndef __LUT
 #define __LUT 1
 
+#include <stdint.h>
+
 #define TRIG_UNIT                   511
+/* Chosen at build time (make ANGLE_UNIT=1024). Finer units give smoother
+ * curves and more arms to the spirals; golden.txt is for 256.
+ */
+#ifndef ANGLE_UNIT
 #define ANGLE_UNIT                  256
+#endif
+#if ANGLE_UNIT != 256 && ANGLE_UNIT != 1024 && ANGLE_UNIT != 4096
+#error "ANGLE_UNIT must be 256, 1024 or 4096"
+#endif
 /* The same idea as 2*PI, PI/2, PI/4, etc. */
 #define ANGLE_UNIT_2                (ANGLE_UNIT*2)
 #define ANGLE_UNIT_HALF             (ANGLE_UNIT/2)
@@ -11,11 +21,57 @@
 #define ANGLE_UNIT_THREE_QUARTERS   (ANGLE_UNIT*3/4)
 
 
-long lut_sin (long angle);
+/* The tables are written by lutgen.c into lut_tables.c. Each has
+ * LUT_GATHER_PAD spare entries at the end so a 32 bit gather of the last
+ * int16_t stays inside it.
+ */
+#define SIN_TABLE_SIZE              ANGLE_UNIT
+#define LUT_GATHER_PAD              1
+
+/* lut_sin() is called several times per pixel, so it is inline */
+extern const int16_t Sin_Table[];
+
+static inline long lut_sin (long a)
+{
+  if (a < 0)
+    a = -a + ANGLE_UNIT_HALF;
+
+  a %= ANGLE_UNIT;
+
+  return (long)Sin_Table [a];
+}
+
 /* long lut_cos (long a);  As a macro */
 #define lut_cos(angle) (lut_sin((angle)+ANGLE_UNIT_QUART))
 long lut_angle (long x, long y);
 long lut_dist (long x, long y);
+
+/* Sets up lut_dist() for a screen size; larger than 2048 gets a finer
+ * frame (Frame_Big_Shift != 0). Also fills the reciprocals
+ * lut_polar_span() uses. Call before any threads use the tables.
+ */
+void lut_init (int xmax, int ymax);
+extern int *Frame_Edge_Distance_Big;
+extern int Frame_Big_Shift;
+
+/* Batch versions in lut_span.c. out[i] gets exactly what the scalar
+ * function returns for point i: lut_dist (dx0 + i, dy),
+ * lut_angle (dx0 + i, dy) and lut_sin (a[i]). They use AVX2 or SSE2
+ * when the CPU has them.
+ */
+#define FRAME_SIZE          1023
+extern const int16_t Frame_Edge_Angle[];
+extern const int16_t Frame_Edge_Distance[];
+
+void lut_dist_span (long dx0, long dy, int n, int32_t *out);
+void lut_angle_span (long dx0, long dy, int n, int32_t *out);
+void lut_sin_span (const int32_t *a, int n, int32_t *out);
+/* A row of both, dist[i] = lut_dist (dx0 + i, dy) and angle[i] =
+ * lut_angle (dx0 + i, dy), with no divide per point. Either may be NULL.
+ */
+void lut_polar_span (long dx0, long dy, int n, uint16_t *dist, uint16_t *angle);
+const char *lut_span_isa (void);
+void lut_span_init (void);	/* called by lut_init() */
 #endif
 
 /* You see, 360 degree, 2*PI radians are more or less arbitrary angle units.
@@ -0,0 +1,587 @@
+/* Batch versions of lut_dist(), lut_angle() and lut_sin().
+ *
+ * The scalar functions branch on the quadrant and do two integer divides
+ * per point, which keeps the compiler from vectorising any loop that calls
+ * them. Here the same steps are done on 8 (AVX2) or 4 (SSE2) points at a
+ * time: the quadrant juggling becomes masks, the divides become multiplies
+ * by a reciprocal estimate that are then corrected to the exact integer
+ * quotient, and the table lookups are gathers. The results are bit for bit
+ * the scalar ones.
+ *
+ * lut_polar_span() does a row of both at once, sharing the frame index
+ * they both look up. Without SIMD it multiplies by a table of exact
+ * fixed point reciprocals instead, so no version divides per point.
+ */
+#include <stdint.h>
+
+#include "handy.h"
+#include "lut.h"
+
+/* Largest |dx| or |dy| the vector code takes. FRAME_SIZE times this and
+ * the largest Frame_Edge_Distance times this both stay below 2^24, so
+ * every intermediate is an exact float. Anything larger goes the scalar way.
+ */
+#define SPAN_MAX 8191
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LUT_SPAN_X86 1
+#include <immintrin.h>
+#endif
+
+static void dist_span_c(long dx0, long dy, int n, int32_t *out)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    out[i] = (int32_t)lut_dist (dx0 + i, dy);
+}
+
+static void angle_span_c(long dx0, long dy, int n, int32_t *out)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    out[i] = (int32_t)lut_angle (dx0 + i, dy);
+}
+
+static void sin_span_c(const int32_t *a, int n, int32_t *out)
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    out[i] = (int32_t)lut_sin (a[i]);
+}
+
+static int span_in_range(long dx0, long dy, int n)
+{
+  return ABS(dy) <= SPAN_MAX && ABS(dx0) <= SPAN_MAX &&
+    ABS(dx0 + n - 1) <= SPAN_MAX;
+}
+
+/* (a * span_recip[b]) >> RECIP_SHIFT == a / b, exactly, for 0 < b <=
+ * SPAN_MAX and 0 <= a < 2^RECIP_SHIFT / SPAN_MAX: span_recip[b] is 2^44 / b
+ * rounded up, and its error times a stays below 2^RECIP_SHIFT. The
+ * numerators here are at most 2^14 * SPAN_MAX, and the products fit in
+ * 64 bits. span_recip[0] is 0, so a zero divisor gives index 0.
+ */
+#define RECIP_SHIFT 44
+
+static uint64_t span_recip[SPAN_MAX + 1];
+
+void lut_span_init (void)
+{
+  long b;
+
+  if (span_recip[1])
+    return;
+  for (b = 1; b <= SPAN_MAX; ++b)
+    span_recip[b] = ((1ULL << RECIP_SHIFT) + b - 1) / b;
+}
+
+static inline long recip_div(long a, long b)
+{
+  return (long)(((uint64_t)a * span_recip[b]) >> RECIP_SHIFT);
+}
+
+/* lut_dist() and lut_angle() by the same steps, along a row */
+static void polar_span_c(long dx0, long dy, int n, uint16_t *dist, uint16_t *angle)
+{
+  const long ady = ABS(dy);
+  const int shift = Frame_Big_Shift;
+  long i, dx, adx, lo, hi, d, a, swap, steep;
+
+  if (!span_recip[1] || !span_in_range (dx0, dy, n) || shift > 14)
+    {
+      /* Tables not set up, or out of their range */
+      for (i = 0; i < n; ++i)
+        {
+          if (dist)
+            dist[i] = (uint16_t)lut_dist (dx0 + i, dy);
+          if (angle)
+            angle[i] = (uint16_t)lut_angle (dx0 + i, dy);
+        }
+      return;
+    }
+
+  /* One loop per output, so nothing but selects is left inside them */
+  if (dist && shift)
+    for (i = 0; i < n; ++i)
+      {
+        adx = ABS(dx0 + i);
+        lo = MIN(adx, ady);
+        hi = MAX(adx, ady);
+        d = (Frame_Edge_Distance_Big[recip_div (lo << shift, hi)] * hi) >> shift;
+        dist[i] = (uint16_t)(lo ? d : hi);
+      }
+  else if (dist)
+    for (i = 0; i < n; ++i)
+      {
+        adx = ABS(dx0 + i);
+        lo = MIN(adx, ady);
+        hi = MAX(adx, ady);
+        d = Frame_Edge_Distance[recip_div (lo * FRAME_SIZE, hi)] * hi / FRAME_SIZE;
+        dist[i] = (uint16_t)(lo ? d : hi);
+      }
+
+  if (angle)
+    for (i = 0; i < n; ++i)
+      {
+        dx = dx0 + i;
+        adx = ABS(dx);
+        lo = MIN(adx, ady);
+        hi = MAX(adx, ady);
+        /* Quadrants 2 and 4 swap the roles of x and y, see lut_angle() */
+        swap = (dx < 0) != (dy < 0);
+        steep = swap ? (ady < adx) : (adx < ady);
+        a = Frame_Edge_Angle[recip_div (lo * FRAME_SIZE, hi)];
+        a = steep ? ANGLE_UNIT_QUART - 1 - a : a;
+        angle[i] = (uint16_t)(a + ((dy < 0) ? ANGLE_UNIT_HALF : 0) + (swap ? ANGLE_UNIT_QUART : 0));
+      }
+}
+
+#ifdef LUT_SPAN_X86
+
+/* ---- SSE2, 4 points at a time ---- */
+
+/* 1 / b to about 22 bits: the hardware estimate and a Newton step */
+__attribute__((target("sse2")))
+static inline __m128 recip_sse2(__m128 b)
+{
+  __m128 r = _mm_rcp_ps (b);
+  return _mm_mul_ps (r, _mm_sub_ps (_mm_set1_ps (2.0f), _mm_mul_ps (b, r)));
+}
+
+/* a / b truncated, for 0 <= a < 2^24 and 0 < b < 2^24 with a quotient
+ * below 2^15, which covers every use here. The estimate is then at most
+ * one off, and a - q*b is exact in float, so one step fixes it.
+ */
+__attribute__((target("sse2")))
+static inline __m128i div_sse2(__m128 a, __m128 b)
+{
+  __m128 q = _mm_cvtepi32_ps (_mm_cvttps_epi32 (_mm_mul_ps (a, recip_sse2 (b))));
+  __m128 r = _mm_sub_ps (a, _mm_mul_ps (q, b));
+  __m128i qi = _mm_cvttps_epi32 (q);
+
+  qi = _mm_add_epi32 (qi, _mm_castps_si128 (_mm_cmplt_ps (r, _mm_setzero_ps ())));
+  qi = _mm_sub_epi32 (qi, _mm_castps_si128 (_mm_cmpge_ps (r, b)));
+  return qi;
+}
+
+__attribute__((target("sse2")))
+static inline __m128i select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i abs_sse2(__m128i v)
+{
+  __m128i s = _mm_srai_epi32 (v, 31);
+  return _mm_sub_epi32 (_mm_xor_si128 (v, s), s);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i gather_sse2(const int16_t *table, __m128i idx)
+{
+  int32_t i[4];
+
+  _mm_storeu_si128 ((__m128i *)i, idx);
+  return _mm_set_epi32 (table[i[3]], table[i[2]], table[i[1]], table[i[0]]);
+}
+
+__attribute__((target("sse2")))
+static void dist_span_sse2(long dx0, long dy, int n, int32_t *out)
+{
+  const __m128i step = _mm_set1_epi32 (4);
+  const __m128 frame = _mm_set1_ps ((float)FRAME_SIZE);
+  __m128i x = _mm_add_epi32 (_mm_set1_epi32 ((int)dx0), _mm_set_epi32 (3, 2, 1, 0));
+  __m128i ay = _mm_set1_epi32 ((int)ABS(dy));
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4, x = _mm_add_epi32 (x, step))
+    {
+      __m128i ax = abs_sse2 (x);
+      __m128i gt = _mm_cmpgt_epi32 (ax, ay);
+      __m128i lo = select_sse2 (gt, ay, ax);
+      __m128i hi = select_sse2 (gt, ax, ay);
+      __m128 hif = _mm_cvtepi32_ps (hi);
+      /* hi is only 0 when lo is too, and that lane is replaced below */
+      __m128 div = _mm_max_ps (hif, _mm_set1_ps (1.0f));
+      __m128i idx = div_sse2 (_mm_mul_ps (_mm_cvtepi32_ps (lo), frame), div);
+      __m128i edge = gather_sse2 (Frame_Edge_Distance, idx);
+      __m128i d = div_sse2 (_mm_mul_ps (_mm_cvtepi32_ps (edge), hif), frame);
+
+      d = select_sse2 (_mm_cmpeq_epi32 (lo, _mm_setzero_si128 ()), hi, d);
+      _mm_storeu_si128 ((__m128i *)(out + i), d);
+    }
+  dist_span_c (dx0 + i, dy, n - i, out + i);
+}
+
+__attribute__((target("sse2")))
+static void angle_span_sse2(long dx0, long dy, int n, int32_t *out)
+{
+  const __m128i step = _mm_set1_epi32 (4);
+  const __m128 frame = _mm_set1_ps ((float)FRAME_SIZE);
+  __m128i x = _mm_add_epi32 (_mm_set1_epi32 ((int)dx0), _mm_set_epi32 (3, 2, 1, 0));
+  __m128i vy = _mm_set1_epi32 ((int)dy);
+  __m128i my = _mm_srai_epi32 (vy, 31);
+  __m128i ay = abs_sse2 (vy);
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4, x = _mm_add_epi32 (x, step))
+    {
+      /* Quadrants 2 and 4 swap the roles of x and y, see lut_angle() */
+      __m128i swap = _mm_xor_si128 (_mm_srai_epi32 (x, 31), my);
+      __m128i ax = abs_sse2 (x);
+      __m128i u = select_sse2 (swap, ay, ax);
+      __m128i v = select_sse2 (swap, ax, ay);
+      __m128i ult = _mm_cmplt_epi32 (u, v);
+      __m128i lo = select_sse2 (ult, u, v);
+      __m128i hi = select_sse2 (ult, v, u);
+      __m128 div = _mm_max_ps (_mm_cvtepi32_ps (hi), _mm_set1_ps (1.0f));
+      __m128i idx = div_sse2 (_mm_mul_ps (_mm_cvtepi32_ps (lo), frame), div);
+      __m128i a = gather_sse2 (Frame_Edge_Angle, idx);
+
+      a = select_sse2 (ult, _mm_sub_epi32 (_mm_set1_epi32 (ANGLE_UNIT_QUART - 1), a), a);
+      a = _mm_add_epi32 (a, _mm_and_si128 (my, _mm_set1_epi32 (ANGLE_UNIT_HALF)));
+      a = _mm_add_epi32 (a, _mm_and_si128 (swap, _mm_set1_epi32 (ANGLE_UNIT_QUART)));
+      _mm_storeu_si128 ((__m128i *)(out + i), a);
+    }
+  angle_span_c (dx0 + i, dy, n - i, out + i);
+}
+
+__attribute__((target("sse2")))
+static void sin_span_sse2(const int32_t *a, int n, int32_t *out)
+{
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *)(a + i));
+      __m128i neg = _mm_srai_epi32 (v, 31);
+      /* a < 0 becomes -a + ANGLE_UNIT_HALF, then modulo ANGLE_UNIT */
+      v = select_sse2 (neg, _mm_sub_epi32 (_mm_set1_epi32 (ANGLE_UNIT_HALF), v), v);
+      v = _mm_and_si128 (v, _mm_set1_epi32 (ANGLE_UNIT - 1));
+      _mm_storeu_si128 ((__m128i *)(out + i), gather_sse2 (Sin_Table, v));
+    }
+  sin_span_c (a + i, n - i, out + i);
+}
+
+/* ---- AVX2, 8 points at a time ---- */
+
+__attribute__((target("avx2")))
+static inline __m256 recip_avx2(__m256 b)
+{
+  __m256 r = _mm256_rcp_ps (b);
+  return _mm256_mul_ps (r, _mm256_sub_ps (_mm256_set1_ps (2.0f), _mm256_mul_ps (b, r)));
+}
+
+/* As div_sse2() */
+__attribute__((target("avx2")))
+static inline __m256i div_avx2(__m256 a, __m256 b)
+{
+  __m256 q = _mm256_round_ps (_mm256_mul_ps (a, recip_avx2 (b)), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_sub_ps (a, _mm256_mul_ps (q, b));
+  __m256i qi = _mm256_cvttps_epi32 (q);
+
+  qi = _mm256_add_epi32 (qi, _mm256_castps_si256 (_mm256_cmp_ps (r, _mm256_setzero_ps (), _CMP_LT_OQ)));
+  qi = _mm256_sub_epi32 (qi, _mm256_castps_si256 (_mm256_cmp_ps (r, b, _CMP_GE_OQ)));
+  return qi;
+}
+
+/* table[idx] from an int16_t table: a 32 bit gather two bytes apart,
+ * keeping the low half. The last entry reads into LUT_GATHER_PAD.
+ */
+__attribute__((target("avx2")))
+static inline __m256i gather16_avx2(const int16_t *table, __m256i idx)
+{
+  __m256i v = _mm256_i32gather_epi32 ((const int *)table, idx, 2);
+  return _mm256_srai_epi32 (_mm256_slli_epi32 (v, 16), 16);
+}
+
+__attribute__((target("avx2")))
+static void dist_span_avx2(long dx0, long dy, int n, int32_t *out)
+{
+  const __m256i step = _mm256_set1_epi32 (8);
+  const __m256 frame = _mm256_set1_ps ((float)FRAME_SIZE);
+  __m256i x = _mm256_add_epi32 (_mm256_set1_epi32 ((int)dx0), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+  __m256i ay = _mm256_set1_epi32 ((int)ABS(dy));
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8, x = _mm256_add_epi32 (x, step))
+    {
+      __m256i ax = _mm256_abs_epi32 (x);
+      __m256i lo = _mm256_min_epi32 (ax, ay);
+      __m256i hi = _mm256_max_epi32 (ax, ay);
+      __m256 hif = _mm256_cvtepi32_ps (hi);
+      __m256 div = _mm256_max_ps (hif, _mm256_set1_ps (1.0f));
+      __m256i idx = div_avx2 (_mm256_mul_ps (_mm256_cvtepi32_ps (lo), frame), div);
+      __m256i edge = gather16_avx2 (Frame_Edge_Distance, idx);
+      __m256i d = div_avx2 (_mm256_mul_ps (_mm256_cvtepi32_ps (edge), hif), frame);
+
+      d = _mm256_blendv_epi8 (d, hi, _mm256_cmpeq_epi32 (lo, _mm256_setzero_si256 ()));
+      _mm256_storeu_si256 ((__m256i *)(out + i), d);
+    }
+  dist_span_c (dx0 + i, dy, n - i, out + i);
+}
+
+/* The same with the larger frame lut_init() sets up for big screens. Its
+ * products no longer fit a float exactly, so the quotient estimate is
+ * corrected with integer multiplies instead.
+ */
+__attribute__((target("avx2")))
+static void dist_span_big_avx2(long dx0, long dy, int n, int32_t *out)
+{
+  const __m256i step = _mm256_set1_epi32 (8);
+  const __m128i shift = _mm_cvtsi32_si128 (Frame_Big_Shift);
+  __m256i x = _mm256_add_epi32 (_mm256_set1_epi32 ((int)dx0), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+  __m256i ay = _mm256_set1_epi32 ((int)ABS(dy));
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8, x = _mm256_add_epi32 (x, step))
+    {
+      __m256i ax = _mm256_abs_epi32 (x);
+      __m256i lo = _mm256_min_epi32 (ax, ay);
+      __m256i hi = _mm256_max_epi32 (ax, ay);
+      __m256i div = _mm256_max_epi32 (hi, _mm256_set1_epi32 (1));
+      __m256i a = _mm256_sll_epi32 (lo, shift);
+      __m256i q = _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (a), recip_avx2 (_mm256_cvtepi32_ps (div))));
+      __m256i r = _mm256_sub_epi32 (a, _mm256_mullo_epi32 (q, div));
+      __m256i edge, d;
+
+      q = _mm256_add_epi32 (q, _mm256_cmpgt_epi32 (_mm256_setzero_si256 (), r));
+      q = _mm256_sub_epi32 (q, _mm256_cmpgt_epi32 (r, _mm256_sub_epi32 (div, _mm256_set1_epi32 (1))));
+      edge = _mm256_i32gather_epi32 (Frame_Edge_Distance_Big, q, 4);
+      d = _mm256_srl_epi32 (_mm256_mullo_epi32 (edge, hi), shift);
+
+      d = _mm256_blendv_epi8 (d, hi, _mm256_cmpeq_epi32 (lo, _mm256_setzero_si256 ()));
+      _mm256_storeu_si256 ((__m256i *)(out + i), d);
+    }
+  dist_span_c (dx0 + i, dy, n - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static void angle_span_avx2(long dx0, long dy, int n, int32_t *out)
+{
+  const __m256i step = _mm256_set1_epi32 (8);
+  const __m256 frame = _mm256_set1_ps ((float)FRAME_SIZE);
+  __m256i x = _mm256_add_epi32 (_mm256_set1_epi32 ((int)dx0), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+  __m256i vy = _mm256_set1_epi32 ((int)dy);
+  __m256i my = _mm256_srai_epi32 (vy, 31);
+  __m256i ay = _mm256_abs_epi32 (vy);
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8, x = _mm256_add_epi32 (x, step))
+    {
+      __m256i swap = _mm256_xor_si256 (_mm256_srai_epi32 (x, 31), my);
+      __m256i ax = _mm256_abs_epi32 (x);
+      __m256i u = _mm256_blendv_epi8 (ax, ay, swap);
+      __m256i v = _mm256_blendv_epi8 (ay, ax, swap);
+      __m256i ult = _mm256_cmpgt_epi32 (v, u);
+      __m256i lo = _mm256_min_epi32 (u, v);
+      __m256i hi = _mm256_max_epi32 (u, v);
+      __m256 div = _mm256_max_ps (_mm256_cvtepi32_ps (hi), _mm256_set1_ps (1.0f));
+      __m256i idx = div_avx2 (_mm256_mul_ps (_mm256_cvtepi32_ps (lo), frame), div);
+      __m256i a = gather16_avx2 (Frame_Edge_Angle, idx);
+
+      a = _mm256_blendv_epi8 (a, _mm256_sub_epi32 (_mm256_set1_epi32 (ANGLE_UNIT_QUART - 1), a), ult);
+      a = _mm256_add_epi32 (a, _mm256_and_si256 (my, _mm256_set1_epi32 (ANGLE_UNIT_HALF)));
+      a = _mm256_add_epi32 (a, _mm256_and_si256 (swap, _mm256_set1_epi32 (ANGLE_UNIT_QUART)));
+      _mm256_storeu_si256 ((__m256i *)(out + i), a);
+    }
+  angle_span_c (dx0 + i, dy, n - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static inline void store_u16_avx2(uint16_t *out, __m256i v)
+{
+  _mm_storeu_si128 ((__m128i *)out, _mm_packus_epi32 (_mm256_castsi256_si128 (v),
+                                                      _mm256_extracti128_si256 (v, 1)));
+}
+
+/* dist_span_avx2(), dist_span_big_avx2() and angle_span_avx2() in one
+ * pass, with the frame index worked out once for both
+ */
+__attribute__((target("avx2")))
+static void polar_span_avx2(long dx0, long dy, int n, uint16_t *dist, uint16_t *angle)
+{
+  const __m256i step = _mm256_set1_epi32 (8);
+  const __m256 frame = _mm256_set1_ps ((float)FRAME_SIZE);
+  const __m256i zero = _mm256_setzero_si256 ();
+  const int big = Frame_Big_Shift;
+  const __m128i shift = _mm_cvtsi32_si128 (big);
+  __m256i x = _mm256_add_epi32 (_mm256_set1_epi32 ((int)dx0), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+  __m256i vy = _mm256_set1_epi32 ((int)dy);
+  __m256i my = _mm256_srai_epi32 (vy, 31);
+  __m256i ay = _mm256_abs_epi32 (vy);
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8, x = _mm256_add_epi32 (x, step))
+    {
+      __m256i ax = _mm256_abs_epi32 (x);
+      __m256i lo = _mm256_min_epi32 (ax, ay);
+      __m256i hi = _mm256_max_epi32 (ax, ay);
+      __m256 hif = _mm256_cvtepi32_ps (hi);
+      __m256 div = _mm256_max_ps (hif, _mm256_set1_ps (1.0f));
+      __m256i idx = div_avx2 (_mm256_mul_ps (_mm256_cvtepi32_ps (lo), frame), div);
+
+      if (dist)
+        {
+          __m256i d;
+
+          if (big)
+            {
+              __m256i divi = _mm256_max_epi32 (hi, _mm256_set1_epi32 (1));
+              __m256i a = _mm256_sll_epi32 (lo, shift);
+              __m256i q = _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (a), recip_avx2 (div)));
+              __m256i r = _mm256_sub_epi32 (a, _mm256_mullo_epi32 (q, divi));
+
+              q = _mm256_add_epi32 (q, _mm256_cmpgt_epi32 (zero, r));
+              q = _mm256_sub_epi32 (q, _mm256_cmpgt_epi32 (r, _mm256_sub_epi32 (divi, _mm256_set1_epi32 (1))));
+              d = _mm256_i32gather_epi32 (Frame_Edge_Distance_Big, q, 4);
+              d = _mm256_srl_epi32 (_mm256_mullo_epi32 (d, hi), shift);
+            }
+          else
+            {
+              d = gather16_avx2 (Frame_Edge_Distance, idx);
+              d = div_avx2 (_mm256_mul_ps (_mm256_cvtepi32_ps (d), hif), frame);
+            }
+          d = _mm256_blendv_epi8 (d, hi, _mm256_cmpeq_epi32 (lo, zero));
+          store_u16_avx2 (dist + i, d);
+        }
+
+      if (angle)
+        {
+          /* Quadrants 2 and 4 swap the roles of x and y, see lut_angle() */
+          __m256i swap = _mm256_xor_si256 (_mm256_srai_epi32 (x, 31), my);
+          __m256i steep = _mm256_blendv_epi8 (_mm256_cmpgt_epi32 (ay, ax), _mm256_cmpgt_epi32 (ax, ay), swap);
+          __m256i a = gather16_avx2 (Frame_Edge_Angle, idx);
+
+          a = _mm256_blendv_epi8 (a, _mm256_sub_epi32 (_mm256_set1_epi32 (ANGLE_UNIT_QUART - 1), a), steep);
+          a = _mm256_add_epi32 (a, _mm256_and_si256 (my, _mm256_set1_epi32 (ANGLE_UNIT_HALF)));
+          a = _mm256_add_epi32 (a, _mm256_and_si256 (swap, _mm256_set1_epi32 (ANGLE_UNIT_QUART)));
+          store_u16_avx2 (angle + i, a);
+        }
+    }
+  polar_span_c (dx0 + i, dy, n - i, dist ? dist + i : NULL, angle ? angle + i : NULL);
+}
+
+__attribute__((target("avx2")))
+static void sin_span_avx2(const int32_t *a, int n, int32_t *out)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *)(a + i));
+      __m256i neg = _mm256_srai_epi32 (v, 31);
+      v = _mm256_blendv_epi8 (v, _mm256_sub_epi32 (_mm256_set1_epi32 (ANGLE_UNIT_HALF), v), neg);
+      v = _mm256_and_si256 (v, _mm256_set1_epi32 (ANGLE_UNIT - 1));
+      _mm256_storeu_si256 ((__m256i *)(out + i), gather16_avx2 (Sin_Table, v));
+    }
+  sin_span_c (a + i, n - i, out + i);
+}
+
+#endif /* LUT_SPAN_X86 */
+
+enum { SPAN_C, SPAN_SSE2, SPAN_AVX2 };
+
+static int span_isa = -1;
+
+/* Pick the widest version the CPU runs, once */
+static int span_level(void)
+{
+  int level = __atomic_load_n (&span_isa, __ATOMIC_RELAXED);
+
+  if (level < 0)
+    {
+      level = SPAN_C;
+#ifdef LUT_SPAN_X86
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        level = SPAN_AVX2;
+      else if (__builtin_cpu_supports ("sse2"))
+        level = SPAN_SSE2;
+#endif
+      __atomic_store_n (&span_isa, level, __ATOMIC_RELAXED);
+    }
+  return level;
+}
+
+const char *lut_span_isa (void)
+{
+  switch (span_level ())
+    {
+    case SPAN_AVX2: return "AVX2";
+    case SPAN_SSE2: return "SSE2";
+    }
+  return "scalar";
+}
+
+void lut_dist_span (long dx0, long dy, int n, int32_t *out)
+{
+  if (n <= 0)
+    return;
+#ifdef LUT_SPAN_X86
+  if (span_in_range (dx0, dy, n))
+    switch (span_level ())
+      {
+      case SPAN_AVX2:
+        if (Frame_Big_Shift)
+          dist_span_big_avx2 (dx0, dy, n, out);
+        else
+          dist_span_avx2 (dx0, dy, n, out);
+        return;
+      case SPAN_SSE2:
+        if (Frame_Big_Shift)
+          break;		/* no 32 bit multiply in SSE2 */
+        dist_span_sse2 (dx0, dy, n, out);
+        return;
+      }
+#endif
+  dist_span_c (dx0, dy, n, out);
+}
+
+void lut_angle_span (long dx0, long dy, int n, int32_t *out)
+{
+  if (n <= 0)
+    return;
+#ifdef LUT_SPAN_X86
+  if (span_in_range (dx0, dy, n))
+    switch (span_level ())
+      {
+      case SPAN_AVX2: angle_span_avx2 (dx0, dy, n, out); return;
+      case SPAN_SSE2: angle_span_sse2 (dx0, dy, n, out); return;
+      }
+#endif
+  angle_span_c (dx0, dy, n, out);
+}
+
+void lut_polar_span (long dx0, long dy, int n, uint16_t *dist, uint16_t *angle)
+{
+  if (n <= 0)
+    return;
+#ifdef LUT_SPAN_X86
+  /* The reciprocal table beats two SSE2 passes, so only AVX2 is used */
+  if (span_in_range (dx0, dy, n) && span_level () == SPAN_AVX2)
+    {
+      polar_span_avx2 (dx0, dy, n, dist, angle);
+      return;
+    }
+#endif
+  polar_span_c (dx0, dy, n, dist, angle);
+}
+
+void lut_sin_span (const int32_t *a, int n, int32_t *out)
+{
+  if (n <= 0)
+    return;
+#ifdef LUT_SPAN_X86
+  switch (span_level ())
+    {
+    case SPAN_AVX2: sin_span_avx2 (a, n, out); return;
+    case SPAN_SSE2: sin_span_sse2 (a, n, out); return;
+    }
+#endif
+  sin_span_c (a, n, out);
+}
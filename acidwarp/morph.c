@@ -0,0 +1,91 @@
+/* Classic images in motion, see "morph.h". */
+#include <string.h>
+
+#include "handy.h"
+#include "lut.h"
+#include "generate.h"
+#include "morph.h"
+#include "polar.h"
+
+/* One full swing takes 3 to 12 seconds */
+#define MORPH_MIN_PERIOD_MS 3000
+#define MORPH_PERIOD_RANGE  9000
+
+int morph_applies(int imageFuncNum)
+{
+  return gen_pattern_is_local(imageFuncNum);
+}
+
+void morph_begin(Morph *m, const GenParams *p)
+{
+  int i, built;
+
+  memset(m, 0, sizeof(*m));
+  m->base = *p;
+  for (i = 0; i < MORPH_DRIFTS; ++i)
+    {
+      m->period_ms[i] = MORPH_MIN_PERIOD_MS + RANDOM(MORPH_PERIOD_RANGE);
+      if (RANDOM(2))
+        m->period_ms[i] = -m->period_ms[i];
+    }
+  m->pc = polar_cache_acquire_margin(p->xmax, p->ymax, p->xcenter, p->ycenter,
+                                     MORPH_MARGIN, &built);
+}
+
+void morph_advance(Morph *m, double elapsed_ms)
+{
+  m->ms += MIN(MAX(elapsed_ms, 0.0), MORPH_MAX_STEP_MS);
+}
+
+/* How far drift i has turned, in angle units */
+static long morph_angle(const Morph *m, int i)
+{
+  return (long)(m->ms * ANGLE_UNIT / m->period_ms[i]);
+}
+
+/* base moved by up to amplitude either way; nothing moves at time 0 */
+static long morph_swing(const Morph *m, int i, long base, long amplitude)
+{
+  return base + lut_sin (morph_angle(m, i)) * amplitude / TRIG_UNIT;
+}
+
+static long morph_turn(const Morph *m, int i, long base)
+{
+  long a = (base + morph_angle(m, i)) % ANGLE_UNIT;
+
+  return (a < 0) ? a + ANGLE_UNIT : a;
+}
+
+void morph_params(const Morph *m, GenParams *p)
+{
+  const GenParams *b = &m->base;
+
+  *p = *b;
+  p->xcenter = (int)morph_swing(m, 0, b->xcenter, MORPH_CENTRE_DRIFT);
+  p->ycenter = (int)morph_swing(m, 1, b->ycenter, MORPH_CENTRE_DRIFT);
+  p->x1 = morph_swing(m, 2, b->x1, MORPH_PARAM_DRIFT);
+  p->x2 = morph_swing(m, 3, b->x2, MORPH_PARAM_DRIFT);
+  p->x3 = morph_swing(m, 4, b->x3, MORPH_PARAM_DRIFT);
+  p->x4 = morph_swing(m, 5, b->x4, MORPH_PARAM_DRIFT);
+  p->y1 = morph_swing(m, 6, b->y1, MORPH_PARAM_DRIFT);
+  p->y2 = morph_swing(m, 7, b->y2, MORPH_PARAM_DRIFT);
+  p->y3 = morph_swing(m, 8, b->y3, MORPH_PARAM_DRIFT);
+  p->y4 = morph_swing(m, 9, b->y4, MORPH_PARAM_DRIFT);
+  p->a1 = morph_turn(m, 10, b->a1);
+  p->a2 = morph_turn(m, 11, b->a2);
+  p->a3 = morph_turn(m, 12, b->a3);
+  p->a4 = morph_turn(m, 13, b->a4);
+}
+
+void morph_frame_done(Morph *m, double ms)
+{
+  ++m->frames;
+  m->total_ms += ms;
+  m->worst_ms = MAX(m->worst_ms, ms);
+}
+
+void morph_end(Morph *m)
+{
+  polar_cache_release(m->pc);
+  m->pc = NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef MORPH_H
+#define MORPH_H
+
+#include "handy.h"
+#include "generate.h"
+#include "polar.h"
+
+/* --morph: classic images whose geometry moves. The centre of the pattern
+ * wanders around where it was drawn, the four centres of cases 2 and 24 to
+ * 27 (x1..y4) wander around theirs and the angles a1..a4 turn, each at its
+ * own random pace, so a new index buffer is made for every frame.
+ *
+ * That stays cheap because every frame reads one polar cache, built once
+ * around the screen centre with a margin wide enough for all the drift,
+ * through generate_frame(); the rows are made by the row kernels on every
+ * worker thread. The player makes the next frame in the background into a
+ * second buffer while the current one is on screen (see pregen.h).
+ */
+#define MORPH_CENTRE_DRIFT  24	/* pixels either way */
+#define MORPH_PARAM_DRIFT   20	/* added to x1..y4, which start within 20 */
+#define MORPH_MARGIN        (POLAR_MARGIN + MORPH_CENTRE_DRIFT + MORPH_PARAM_DRIFT)
+#define MORPH_BUDGET_MS     10.0	/* per 1080p frame, to keep up with 60 Hz */
+#define MORPH_MAX_STEP_MS   100.0	/* a pause does not make the picture jump */
+
+/* Centre x and y, x1..x4, y1..y4 and a1..a4 */
+#define MORPH_DRIFTS 14
+
+typedef struct {
+  GenParams base;		/* as drawn, and the picture at time 0 */
+  const PolarCache *pc;		/* NULL without the polar cache */
+  long period_ms[MORPH_DRIFTS];	/* negative ones run backwards */
+  double ms;			/* the morph's own clock */
+  /* Frames made so far, for the budget report */
+  long frames;
+  double total_ms, worst_ms;
+} Morph;
+
+/* FALSE for the patterns that stay still: the rain patterns read their
+ * neighbours, so they are redrawn whole and would only flicker.
+ */
+int  morph_applies(int imageFuncNum);
+/* Draws the paces (from the session's random numbers, like the image
+ * parameters) and acquires the cache. Call on the main thread.
+ */
+void morph_begin(Morph *m, const GenParams *p);
+void morph_advance(Morph *m, double elapsed_ms);
+/* The parameters of the frame at the morph's current time */
+void morph_params(const Morph *m, GenParams *p);
+/* Counts a finished frame that took ms to make */
+void morph_frame_done(Morph *m, double ms);
+void morph_end(Morph *m);
+
+#endif // MORPH_H
@@ -0,0 +1,374 @@
+/* Pan and zoom over the plane of a classic pattern, see "pan.h". */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "handy.h"
+#include "generate.h"
+#include "pan.h"
+#include "userpat.h"
+
+#define PAN_MAX_THREADS   16
+#define PAN_HASH_SIZE     4096	/* buckets, a power of two */
+#define PAN_COARSER       3	/* levels up to look for a stand-in */
+#define PAN_STALE_FRAMES  8	/* requests not renewed for this long are dropped */
+
+enum { TILE_QUEUED, TILE_BUSY, TILE_READY };
+
+typedef struct PanTile {
+  /* The key */
+  int      func, level;
+  uint64_t seed;
+  long     tx, ty;
+
+  int      state;
+  int      urgent;		/* on screen rather than prefetched */
+  unsigned wanted;		/* pan_frame it was last asked for in */
+  UCHAR   *pix;			/* PAN_TILE x PAN_TILE */
+  struct PanTile *hnext;	/* hash chain */
+  struct PanTile *older, *newer;	/* LRU list */
+  struct PanTile *qnext;	/* requests, oldest first */
+} PanTile;
+
+/* Everything below is under pan_lock */
+static pthread_mutex_t pan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pan_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t pan_threads[PAN_MAX_THREADS];
+static int       pan_nthreads, pan_quit;
+
+static GenParams pan_params;
+static uint64_t  pan_seed;
+static unsigned  pan_frame;
+
+static PanTile  *pan_hash[PAN_HASH_SIZE];
+static PanTile  *lru_newest, *lru_oldest;
+static PanTile  *queue, **queue_tail = &queue;
+static long      pan_tiles, pan_max_tiles;
+
+/* a / b rounded down, b > 0 */
+static inline long floor_div(long a, long b)
+{
+  return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/* The parameters are drawn together with the pattern's random stream, so
+ * the stream's state tells one draw from another.
+ */
+static uint64_t params_seed(const GenParams *p)
+{
+  return ((uint64_t)p->rng.s[0] << 32 | p->rng.s[1]) ^ p->rng.s[2] ^ ((uint64_t)p->rng.s[3] << 16);
+}
+
+static unsigned hash_key(int func, uint64_t seed, int level, long tx, long ty)
+{
+  uint64_t h = seed ^ ((uint64_t)func << 40) ^ ((uint64_t)level << 56);
+
+  h = (h ^ (uint64_t)tx) * 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (uint64_t)ty) * 0x9e3779b97f4a7c15ULL;
+  return (unsigned)(h >> 32) & (PAN_HASH_SIZE - 1);
+}
+
+static PanTile *find_tile(int level, long tx, long ty)
+{
+  PanTile *t = pan_hash[hash_key(pan_params.imageFuncNum, pan_seed, level, tx, ty)];
+
+  for (; t; t = t->hnext)
+    if (t->tx == tx && t->ty == ty && t->level == level &&
+        t->func == pan_params.imageFuncNum && t->seed == pan_seed)
+      return t;
+  return NULL;
+}
+
+static void lru_unlink(PanTile *t)
+{
+  if (t->older) t->older->newer = t->newer; else lru_oldest = t->newer;
+  if (t->newer) t->newer->older = t->older; else lru_newest = t->older;
+}
+
+static void lru_push(PanTile *t)
+{
+  t->older = lru_newest;
+  t->newer = NULL;
+  if (lru_newest) lru_newest->newer = t; else lru_oldest = t;
+  lru_newest = t;
+}
+
+/* Off the hash and the LRU list; the caller has it off the queue */
+static void drop_tile(PanTile *t)
+{
+  PanTile **link = &pan_hash[hash_key(t->func, t->seed, t->level, t->tx, t->ty)];
+
+  while (*link != t)
+    link = &(*link)->hnext;
+  *link = t->hnext;
+  lru_unlink(t);
+  free(t->pix);
+  free(t);
+  --pan_tiles;
+}
+
+/* Makes room by dropping the least recently used finished tiles that are
+ * not on screen; tiles being made are left alone.
+ */
+static void evict(void)
+{
+  PanTile *t = lru_oldest, *next;
+
+  while (t && pan_tiles >= pan_max_tiles)
+    {
+      next = t->newer;
+      if (t->state == TILE_READY && t->wanted != pan_frame)
+        drop_tile(t);
+      t = next;
+    }
+}
+
+static PanTile *new_tile(int level, long tx, long ty, int state)
+{
+  PanTile *t;
+  unsigned h;
+
+  evict();
+  t = (PanTile *)calloc(1, sizeof(PanTile));
+  if (!t || !(t->pix = (UCHAR *)malloc(PAN_TILE * PAN_TILE)))
+    {
+      free(t);
+      return NULL;
+    }
+  t->func = pan_params.imageFuncNum;
+  t->seed = pan_seed;
+  t->level = level;
+  t->tx = tx;
+  t->ty = ty;
+  t->state = state;
+  t->wanted = pan_frame;
+  h = hash_key(t->func, t->seed, level, tx, ty);
+  t->hnext = pan_hash[h];
+  pan_hash[h] = t;
+  lru_push(t);
+  ++pan_tiles;
+  return t;
+}
+
+/* The tile, asked for if it is not there; NULL only when out of memory */
+static PanTile *want_tile(int level, long tx, long ty, int urgent, int *queued)
+{
+  PanTile *t = find_tile(level, tx, ty);
+
+  if (t)
+    {
+      lru_unlink(t);
+      lru_push(t);
+    }
+  else if ((t = new_tile(level, tx, ty, TILE_QUEUED)) != NULL)
+    {
+      *queue_tail = t;
+      queue_tail = &t->qnext;
+      ++*queued;
+    }
+  else
+    return NULL;
+  t->wanted = pan_frame;
+  t->urgent |= urgent;
+  return t;
+}
+
+/* The request to make next: one on screen now before one that is only
+ * prefetched, otherwise the oldest. Requests that are no longer wanted, or
+ * for another pattern, are dropped on the way.
+ */
+static PanTile *next_request(void)
+{
+  PanTile **link = &queue, **best = NULL, *t;
+  int prio, best_prio = -1;
+
+  while ((t = *link) != NULL)
+    {
+      if (pan_frame - t->wanted > PAN_STALE_FRAMES ||
+          t->func != pan_params.imageFuncNum || t->seed != pan_seed)
+        {
+          *link = t->qnext;
+          drop_tile(t);
+          continue;
+        }
+      prio = 2 * (t->wanted == pan_frame) + t->urgent;
+      if (prio > best_prio)
+        {
+          best_prio = prio;
+          best = link;
+        }
+      link = &t->qnext;
+    }
+  queue_tail = link;
+
+  if (!best)
+    return NULL;
+  t = *best;
+  *best = t->qnext;
+  if (!t->qnext)
+    queue_tail = best;
+  t->qnext = NULL;
+  return t;
+}
+
+static void *pan_main(void *arg)
+{
+  GenParams p;
+  PanTile *t;
+  long step;
+  int made;
+
+  (void)arg;
+  pthread_mutex_lock(&pan_lock);
+  for (;;)
+    {
+      while (!pan_quit && !(t = next_request()))
+        pthread_cond_wait(&pan_wake, &pan_lock);
+      if (pan_quit)
+        break;
+      t->state = TILE_BUSY;
+      p = pan_params;
+      pthread_mutex_unlock(&pan_lock);
+
+      step = 1L << t->level;
+      made = generate_tile(&p, t->tx * PAN_TILE * step, t->ty * PAN_TILE * step, (int)step, PAN_TILE, t->pix);
+
+      pthread_mutex_lock(&pan_lock);
+      /* Out of memory: forget it, and it is asked for again while it is
+         still on screen */
+      if (made != 0)
+        drop_tile(t);
+      else
+        t->state = TILE_READY;
+    }
+  pthread_mutex_unlock(&pan_lock);
+  return NULL;
+}
+
+int pan_init(int nthreads, size_t budget)
+{
+  pan_max_tiles = MAX(budget / (PAN_TILE * PAN_TILE + sizeof(PanTile)), 64);
+  nthreads = MIN(MAX(nthreads, 1), PAN_MAX_THREADS);
+  for (pan_nthreads = 0; pan_nthreads < nthreads; ++pan_nthreads)
+    if (pthread_create(&pan_threads[pan_nthreads], NULL, pan_main, NULL) != 0)
+      break;
+  return pan_nthreads > 0;
+}
+
+void pan_shutdown(void)
+{
+  int i;
+
+  pthread_mutex_lock(&pan_lock);
+  pan_quit = TRUE;
+  pthread_cond_broadcast(&pan_wake);
+  pthread_mutex_unlock(&pan_lock);
+  for (i = 0; i < pan_nthreads; ++i)
+    pthread_join(pan_threads[i], NULL);
+  pan_nthreads = 0;
+}
+
+int pan_applies(int imageFuncNum)
+{
+  return gen_pattern_is_local(imageFuncNum) && !userpat_get(imageFuncNum);
+}
+
+void pan_set_pattern(const GenParams *p, const UCHAR *image)
+{
+  PanTile *t;
+  long tx, ty, y;
+
+  pthread_mutex_lock(&pan_lock);
+  pan_params = *p;
+  pan_seed = params_seed(p);
+  ++pan_frame;
+  for (ty = 0; image && (ty + 1) * PAN_TILE <= p->ymax; ++ty)
+    for (tx = 0; (tx + 1) * PAN_TILE <= p->xmax; ++tx)
+      if (!find_tile(0, tx, ty) && (t = new_tile(0, tx, ty, TILE_READY)) != NULL)
+        for (y = 0; y < PAN_TILE; ++y)
+          memcpy(t->pix + y * PAN_TILE, image + (ty * PAN_TILE + y) * p->xmax + tx * PAN_TILE, PAN_TILE);
+  pthread_mutex_unlock(&pan_lock);
+}
+
+/* Fills the part of the screen level tile (tx, ty) covers from t, a tile
+ * k levels coarser that contains it, or with color 0 if t is NULL.
+ */
+static void draw_tile(UCHAR *buf, int width, int height, long u0, long v0,
+                      long tx, long ty, const PanTile *t, int k)
+{
+  const long sx0 = MAX(0, tx * PAN_TILE - u0), sx1 = MIN(width, (tx + 1) * PAN_TILE - u0);
+  const long sy0 = MAX(0, ty * PAN_TILE - v0), sy1 = MIN(height, (ty + 1) * PAN_TILE - v0);
+  const long scale = 1L << k;
+  const UCHAR *src;
+  UCHAR *dst;
+  long sx, sy;
+
+  for (sy = sy0; sy < sy1; ++sy)
+    {
+      dst = buf + sy * width;
+      if (!t)
+        {
+          memset(dst + sx0, 0, sx1 - sx0);
+          continue;
+        }
+      src = t->pix + (floor_div(v0 + sy, scale) - t->ty * PAN_TILE) * PAN_TILE - t->tx * PAN_TILE;
+      if (k == 0)
+        memcpy(dst + sx0, src + u0 + sx0, sx1 - sx0);
+      else
+        for (sx = sx0; sx < sx1; ++sx)
+          dst[sx] = src[floor_div(u0 + sx, scale)];
+    }
+}
+
+int pan_render(UCHAR *buf, int width, int height, long vx, long vy, int level, int dirx, int diry)
+{
+  const long step = 1L << level;
+  const long u0 = floor_div(vx, step), v0 = floor_div(vy, step);
+  const long tx0 = floor_div(u0, PAN_TILE), tx1 = floor_div(u0 + width - 1, PAN_TILE);
+  const long ty0 = floor_div(v0, PAN_TILE), ty1 = floor_div(v0 + height - 1, PAN_TILE);
+  long tx, ty;
+  int k, missing = 0, queued = 0;
+  PanTile *t, *stand_in;
+
+  pthread_mutex_lock(&pan_lock);
+  ++pan_frame;
+  for (ty = ty0; ty <= ty1; ++ty)
+    for (tx = tx0; tx <= tx1; ++tx)
+      {
+        t = want_tile(level, tx, ty, TRUE, &queued);
+        if (t && t->state == TILE_READY)
+          {
+            draw_tile(buf, width, height, u0, v0, tx, ty, t, 0);
+            continue;
+          }
+        ++missing;
+        stand_in = NULL;
+        for (k = 1; k <= PAN_COARSER && level + k <= PAN_MAX_LEVEL && !stand_in; ++k)
+          if ((stand_in = find_tile(level + k, floor_div(tx, 1L << k), floor_div(ty, 1L << k))) &&
+              stand_in->state != TILE_READY)
+            stand_in = NULL;
+        draw_tile(buf, width, height, u0, v0, tx, ty, stand_in, stand_in ? k - 1 : 0);
+      }
+
+  /* The next row or column of tiles the view is moving into */
+  if (dirx)
+    for (ty = ty0; ty <= ty1; ++ty)
+      want_tile(level, (dirx > 0) ? tx1 + 1 : tx0 - 1, ty, FALSE, &queued);
+  if (diry)
+    for (tx = tx0; tx <= tx1; ++tx)
+      want_tile(level, tx, (diry > 0) ? ty1 + 1 : ty0 - 1, FALSE, &queued);
+
+  if (queued)
+    pthread_cond_broadcast(&pan_wake);
+  pthread_mutex_unlock(&pan_lock);
+  return missing;
+}
+
+void pan_usage(size_t *bytes, int *tiles)
+{
+  pthread_mutex_lock(&pan_lock);
+  *tiles = (int)pan_tiles;
+  *bytes = (size_t)pan_tiles * PAN_TILE * PAN_TILE;
+  pthread_mutex_unlock(&pan_lock);
+}
@@ -0,0 +1,44 @@
+#ifndef PAN_H
+#define PAN_H
+
+#include <stddef.h>
+
+#include "handy.h"
+#include "generate.h"
+
+/* --pan: the classic formulas are defined over the whole integer plane,
+ * not just the screen, so pan mode lets you move around it and zoom out.
+ *
+ * The plane is made in PAN_TILE square tiles, on demand, by threads of
+ * their own. Tiles are kept in an LRU cache keyed by pattern, the seed of
+ * its parameters, zoom level and tile position. pan_render() never waits
+ * for one: it asks for what is missing, draws it meanwhile from a coarser
+ * level if it has one, and also asks for the tiles just past the edge of
+ * the view in the direction it is moving. So the palette keeps turning
+ * however fast the view moves.
+ *
+ * Level L has one sample every 2^L plane units. The formulas have no detail
+ * finer than a unit, so level 0 is the closest.
+ */
+#define PAN_TILE        128
+#define PAN_MAX_LEVEL   4
+#define PAN_CACHE_BYTES (64L * 1024 * 1024)
+/* lut_dist() rows are 16 bit, so stay this close to the centre */
+#define PAN_REACH       30000
+
+int  pan_init(int nthreads, size_t budget);	/* FALSE: no threads, no panning */
+void pan_shutdown(void);
+/* Loaded patterns and the rain cannot be cut into tiles */
+int  pan_applies(int imageFuncNum);
+/* Pans over this image from now on. image, if not NULL, is the picture p
+ * describes, and the tiles it covers are taken from it.
+ */
+void pan_set_pattern(const GenParams *p, const UCHAR *image);
+/* Draws width x height pixels of level, pixel (0, 0) at plane point
+ * (vx, vy), into buf. (dirx, diry) is the way the view is moving, for the
+ * prefetching. Returns the number of tiles not there yet.
+ */
+int  pan_render(UCHAR *buf, int width, int height, long vx, long vy, int level, int dirx, int diry);
+void pan_usage(size_t *bytes, int *tiles);
+
+#endif // PAN_H
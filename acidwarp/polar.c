@@ -0,0 +1,147 @@
+/* Cached distance and angle fields for the classic image generator. */
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "handy.h"
+#include "lut.h"
+#include "polar.h"
+#include "workpool.h"
+
+/* Two entries covers the screen plus one other size (a thumbnail, say)
+ * without rebuilding every time they alternate.
+ */
+#define POLAR_CACHE_ENTRIES    2
+#define POLAR_CACHE_MAX_BYTES  (256L * 1024 * 1024)
+#define POLAR_BANDS_PER_THREAD 4
+
+int polar_cache_enabled = TRUE;
+
+static PolarCache *cache_list = NULL;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+  PolarCache *pc;
+  int rows, nbands;
+} BuildJob;
+
+static void build_band(void *ctx, int band)
+{
+  const BuildJob *job = (const BuildJob *)ctx;
+  PolarCache *pc = job->pc;
+  long Y, i;
+  long yend = (long)job->rows * (band + 1) / job->nbands;
+
+  for (Y = (long)job->rows * band / job->nbands; Y < yend; ++Y)
+    {
+      i = Y * pc->stride;
+      lut_polar_span (-pc->margin - pc->xcenter, Y - pc->margin - pc->ycenter,
+                      pc->stride, pc->dist + i, pc->angle + i);
+    }
+}
+
+static PolarCache *build_cache(int xmax, int ymax, int xcenter, int ycenter, int margin)
+{
+  PolarCache *pc;
+  BuildJob job;
+  size_t cells;
+  double start = MSEC_NOW();
+
+  cells = (size_t)(xmax + 2 * margin) * (ymax + 2 * margin);
+  if (cells * 2 * sizeof(uint16_t) > POLAR_CACHE_MAX_BYTES)
+    return NULL;
+
+  pc = (PolarCache *)calloc(1, sizeof(PolarCache));
+  if (!pc)
+    return NULL;
+  pc->xmax = xmax;  pc->ymax = ymax;
+  pc->xcenter = xcenter;  pc->ycenter = ycenter;
+  pc->margin = margin;
+  pc->stride = xmax + 2 * margin;
+  pc->bytes = cells * 2 * sizeof(uint16_t);
+  pc->dist  = (uint16_t *)malloc(cells * sizeof(uint16_t));
+  pc->angle = (uint16_t *)malloc(cells * sizeof(uint16_t));
+  if (!pc->dist || !pc->angle)
+    {
+      free(pc->dist);
+      free(pc->angle);
+      free(pc);
+      return NULL;
+    }
+
+  job.pc = pc;
+  job.rows = ymax + 2 * margin;
+  job.nbands = MIN(job.rows, workpool_size() * POLAR_BANDS_PER_THREAD);
+  workpool_run(build_band, &job, job.nbands);
+
+  pc->build_ms = MSEC_NOW() - start;
+  return pc;
+}
+
+/* Drop unused entries beyond the first POLAR_CACHE_ENTRIES */
+static void trim_cache(void)
+{
+  PolarCache **link = &cache_list, *pc;
+  int kept = 0;
+
+  while ((pc = *link) != NULL)
+    {
+      if (pc->refs == 0 && kept >= POLAR_CACHE_ENTRIES)
+        {
+          *link = pc->next;
+          free(pc->dist);
+          free(pc->angle);
+          free(pc);
+          continue;
+        }
+      ++kept;
+      link = &pc->next;
+    }
+}
+
+const PolarCache *polar_cache_acquire(int xmax, int ymax, int xcenter, int ycenter, int *built)
+{
+  return polar_cache_acquire_margin(xmax, ymax, xcenter, ycenter, POLAR_MARGIN, built);
+}
+
+const PolarCache *polar_cache_acquire_margin(int xmax, int ymax, int xcenter, int ycenter,
+                                             int margin, int *built)
+{
+  PolarCache **link, *pc;
+
+  *built = FALSE;
+  if (!polar_cache_enabled)
+    return NULL;
+
+  pthread_mutex_lock(&cache_lock);
+  for (link = &cache_list; (pc = *link) != NULL; link = &pc->next)
+    if (pc->xmax == xmax && pc->ymax == ymax &&
+        pc->xcenter == xcenter && pc->ycenter == ycenter && pc->margin >= margin)
+      {
+        /* Move to the front, most recently used first */
+        *link = pc->next;
+        break;
+      }
+
+  if (!pc)
+    *built = (pc = build_cache(xmax, ymax, xcenter, ycenter, margin)) != NULL;
+
+  if (pc)
+    {
+      ++pc->refs;
+      pc->next = cache_list;
+      cache_list = pc;
+      trim_cache();
+    }
+  pthread_mutex_unlock(&cache_lock);
+  return pc;
+}
+
+void polar_cache_release(const PolarCache *pc)
+{
+  if (!pc)
+    return;
+  pthread_mutex_lock(&cache_lock);
+  --((PolarCache *)pc)->refs;
+  trim_cache();
+  pthread_mutex_unlock(&cache_lock);
+}
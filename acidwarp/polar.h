@@ -0,0 +1,50 @@
+#ifndef POLAR_H
+#define POLAR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Every classic image is built around the same centre, so lut_dist() and
+ * lut_angle() of every pixel only need working out once per resolution.
+ * The fields are POLAR_MARGIN pixels larger than the screen on every side,
+ * so patterns whose centres are offset by up to that much read the same
+ * field through a shifted window.
+ */
+#define POLAR_MARGIN 20
+
+typedef struct PolarCache {
+  int xmax, ymax, xcenter, ycenter;
+  int margin, stride;          /* stride = xmax + 2 * margin */
+  uint16_t *dist;              /* (ymax + 2 * margin) rows of stride */
+  uint16_t *angle;
+  size_t bytes;
+  double build_ms;
+  int refs;
+  struct PolarCache *next;
+} PolarCache;
+
+extern int polar_cache_enabled;
+
+/* NULL if caching is off or the frame is too large to cache. *built is
+ * set when this call had to build the fields.
+ */
+const PolarCache *polar_cache_acquire(int xmax, int ymax, int xcenter, int ycenter, int *built);
+/* The same with a wider margin than POLAR_MARGIN, for centres that move */
+const PolarCache *polar_cache_acquire_margin(int xmax, int ymax, int xcenter, int ycenter,
+                                             int margin, int *built);
+void polar_cache_release(const PolarCache *pc);
+
+/* Field values for pixel row y, with the centre moved by (-ox, -oy):
+ * row[x] == lut_dist(x - xcenter + ox, y - ycenter + oy)
+ */
+static inline const uint16_t *polar_dist_row(const PolarCache *pc, long y, long ox, long oy)
+{
+  return pc->dist + (y + oy + pc->margin) * pc->stride + ox + pc->margin;
+}
+
+static inline const uint16_t *polar_angle_row(const PolarCache *pc, long y, long ox, long oy)
+{
+  return pc->angle + (y + oy + pc->margin) * pc->stride + ox + pc->margin;
+}
+
+#endif // POLAR_H
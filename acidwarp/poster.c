@@ -0,0 +1,285 @@
+/* acidwarp-poster: renders one classic image, of any size, to a PPM file.
+ *
+ * A 60000x60000 image is 3.6 GB of indices, so the image is never held
+ * whole. It is made in strips of --strip-rows rows, several at once on the
+ * worker threads (the rain patterns a strip at a time, see
+ * generate_strip()), and a writer thread of its own takes the finished
+ * strips in order, colors them through the palette and writes them out,
+ * while the next strips are being made. There are two strips per thread,
+ * so memory depends on the width alone, not on the height.
+ *
+ * --seed, --image-func and --palette choose the picture, the same way as
+ * in the player; the random parameters are drawn for the poster's size.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "handy.h"
+#include "acidwarp.h"
+#include "generate.h"
+#include "lut.h"
+#include "palinit.h"
+#include "userpat.h"
+#include "workpool.h"
+
+#define NUM_PATTERNS 41
+#define WRITE_BUFFER (1 << 20)
+
+typedef struct {
+  GenParams p;
+  long strip_rows, nstrips;
+  int nslots;
+  UCHAR *slots;			/* nslots of a row above and strip_rows rows */
+  long first;			/* the strip the first task of a batch makes */
+  int failed;			/* set by any worker, so atomically */
+
+  UCHAR rgb[256 * 3];		/* the palette, 8 bits a channel */
+  UCHAR *line;			/* the writer's RGB row */
+  FILE *out;
+
+  /* Strips made and strips written out, under lock */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  long made, written;
+  int stop;			/* no more strips are coming */
+  int write_error;
+} Poster;
+
+static UCHAR *slot_rows(Poster *ps, long strip)
+{
+  return ps->slots + (strip % ps->nslots) * (ps->strip_rows + 1) * ps->p.xmax + ps->p.xmax;
+}
+
+static long strip_height(const Poster *ps, long strip)
+{
+  return MIN(ps->strip_rows, ps->p.ymax - strip * ps->strip_rows);
+}
+
+static void make_strip(void *ctx, int task)
+{
+  Poster *ps = (Poster *)ctx;
+  long strip = ps->first + task;
+
+  if (generate_strip(&ps->p, strip * ps->strip_rows, ps->strip_rows, slot_rows(ps, strip)) != 0)
+    __atomic_store_n(&ps->failed, TRUE, __ATOMIC_RELAXED);
+}
+
+static void *writer_main(void *arg)
+{
+  Poster *ps = (Poster *)arg;
+  const long xmax = ps->p.xmax;
+  UCHAR *line = ps->line;
+  const UCHAR *src;
+  long strip, y, x;
+  int error = FALSE, made;
+
+  for (strip = 0; strip < ps->nstrips && !error; ++strip)
+    {
+      pthread_mutex_lock(&ps->lock);
+      while (ps->made <= strip && !ps->stop)
+	pthread_cond_wait(&ps->changed, &ps->lock);
+      made = (ps->made > strip);
+      pthread_mutex_unlock(&ps->lock);
+      if (!made)
+	break;			/* stopped; the slot holds an old strip */
+
+      src = slot_rows(ps, strip);
+      for (y = 0; y < strip_height(ps, strip) && !error; ++y, src += xmax)
+	{
+	  for (x = 0; x < xmax; ++x)
+	    memcpy(line + 3 * x, ps->rgb + 3 * src[x], 3);
+	  error = (fwrite(line, 3, xmax, ps->out) != (size_t)xmax);
+	}
+
+      pthread_mutex_lock(&ps->lock);
+      ps->written = strip + 1;
+      pthread_cond_signal(&ps->changed);
+      pthread_mutex_unlock(&ps->lock);
+    }
+
+  pthread_mutex_lock(&ps->lock);
+  ps->write_error = error;
+  ps->written = ps->nstrips;	/* nobody waits on a failed writer */
+  pthread_cond_signal(&ps->changed);
+  pthread_mutex_unlock(&ps->lock);
+  return NULL;
+}
+
+/* Hands strips to the writer as they are made, never more than nslots
+ * ahead of it.
+ */
+static int render(Poster *ps)
+{
+  const int local = gen_pattern_is_local(ps->p.imageFuncNum);
+  const int batch = local ? workpool_size() : 1;
+  const long xmax = ps->p.xmax;
+  pthread_t writer;
+  long n;
+  int gave_up;
+
+  if (pthread_create(&writer, NULL, writer_main, ps) != 0)
+    return (-1);
+  for (ps->first = 0; ps->first < ps->nstrips && !__atomic_load_n(&ps->failed, __ATOMIC_RELAXED); ps->first += n)
+    {
+      n = MIN(batch, ps->nstrips - ps->first);
+      pthread_mutex_lock(&ps->lock);
+      while (ps->written < ps->first + n - ps->nslots)
+	pthread_cond_wait(&ps->changed, &ps->lock);
+      gave_up = ps->write_error;
+      pthread_mutex_unlock(&ps->lock);
+      if (gave_up)
+	break;
+
+      /* The rain reads on from the last row of the strip before */
+      if (!local && ps->first > 0)
+	memcpy(slot_rows(ps, ps->first) - xmax,
+	       slot_rows(ps, ps->first - 1) + (ps->strip_rows - 1) * xmax, xmax);
+      if (local)
+	workpool_run(make_strip, ps, (int)n);
+      else
+	make_strip(ps, 0);	/* its tiles go to the workers */
+
+      if (__atomic_load_n(&ps->failed, __ATOMIC_RELAXED))
+	break;			/* the batch is incomplete, so not made */
+      pthread_mutex_lock(&ps->lock);
+      ps->made = ps->first + n;
+      pthread_cond_signal(&ps->changed);
+      pthread_mutex_unlock(&ps->lock);
+    }
+  /* Stop the writer at the first strip that was not made */
+  pthread_mutex_lock(&ps->lock);
+  ps->stop = TRUE;
+  pthread_cond_signal(&ps->changed);
+  pthread_mutex_unlock(&ps->lock);
+  pthread_join(writer, NULL);
+  return (ps->failed || ps->write_error) ? -1 : 0;
+}
+
+static void usage(const char *argv0)
+{
+  printf("Usage: %s --size WxH --out FILE.ppm [--image-func N] [--palette N] [--seed N]\n"
+	 "       [--threads N] [--strip-rows N] [--pattern-file FILE]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  static Poster ps;
+  int width = 0, height = 0, image_func = -1, palette = RGBW_PAL, threads = 0;
+  int seed_given = FALSE;
+  uint64_t seed = 0;
+  long strip_rows = GEN_STRIP_ALIGN;
+  const char *out_path = NULL, *pattern_file = NULL;
+  UCHAR pal[256 * 3];
+  double start, ms;
+  struct stat st;
+  int i, loaded = 0;
+
+  for (i = 1; i < argc; ++i)
+    {
+      if (strcmp(argv[i], "--size") == 0 && i+1 < argc)
+	{
+	  if (sscanf(argv[++i], "%dx%d", &width, &height) != 2)
+	    width = height = 0;
+	}
+      else if (strcmp(argv[i], "--out") == 0 && i+1 < argc)
+	out_path = argv[++i];
+      else if (strcmp(argv[i], "--image-func") == 0 && i+1 < argc)
+	image_func = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--palette") == 0 && i+1 < argc)
+	palette = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+	{
+	  seed = strtoull(argv[++i], NULL, 0);
+	  seed_given = TRUE;
+	}
+      else if (strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+	threads = atoi(argv[++i]);
+      else if (strcmp(argv[i], "--strip-rows") == 0 && i+1 < argc)
+	strip_rows = atol(argv[++i]);
+      else if (strcmp(argv[i], "--pattern-file") == 0 && i+1 < argc)
+	pattern_file = argv[++i];
+      else
+	{
+	  usage(argv[0]);
+	  exit(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1);
+	}
+    }
+  if (width <= 0 || height <= 0 || out_path == NULL ||
+      palette < 0 || palette >= NUM_PALETTE_TYPES)
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+  /* Whole rows of rain tiles */
+  strip_rows = MAX((strip_rows + GEN_STRIP_ALIGN - 1) / GEN_STRIP_ALIGN, 1) * GEN_STRIP_ALIGN;
+
+  if (pattern_file != NULL && (loaded = userpat_load(pattern_file)) < 0)
+    exit(1);
+  if (seed_given)
+    rng_session_seed(seed);
+  else
+    RANDOMIZE();
+  if (image_func < 0)
+    {
+      image_func = RANDOM(NUM_PATTERNS + loaded);
+      if (image_func >= NUM_PATTERNS)
+	image_func = USERPAT_FIRST + image_func - NUM_PATTERNS;
+    }
+
+  lut_init(width, height);
+  workpool_init(threads);
+  gen_draw_params(&ps.p, image_func, width / 2, height / 2, width, height, 255);
+  initPalArray(pal, palette);
+  for (i = 0; i < 256 * 3; ++i)
+    ps.rgb[i] = (UCHAR)((pal[i] << 2) | (pal[i] >> 4));
+
+  ps.strip_rows = strip_rows;
+  ps.nstrips = (height + strip_rows - 1) / strip_rows;
+  ps.nslots = (int)MIN(2 * workpool_size(), ps.nstrips);
+  ps.slots = (UCHAR *)malloc((size_t)ps.nslots * (strip_rows + 1) * width);
+  ps.line = (UCHAR *)malloc((size_t)width * 3);
+  if (!ps.slots || !ps.line)
+    {
+      fprintf(stderr, "acidwarp-poster: no memory for the strips\n");
+      exit(1);
+    }
+  if (!(ps.out = fopen(out_path, "wb")))
+    {
+      fprintf(stderr, "acidwarp-poster: cannot write the output file\n");
+      exit(1);
+    }
+  setvbuf(ps.out, NULL, _IOFBF, WRITE_BUFFER);
+  pthread_mutex_init(&ps.lock, NULL);
+  pthread_cond_init(&ps.changed, NULL);
+
+  fprintf(stderr, "[INFO] pattern %d, palette %d, %dx%d in %ld strips of %ld rows, %d thread(s), "
+	  "%.1f MB of strips (--seed %llu)\n", image_func, palette, width, height, ps.nstrips,
+	  strip_rows, workpool_size(), (double)ps.nslots * (strip_rows + 1) * width / (1024.0 * 1024.0),
+	  (unsigned long long)rng_session_seed_value());
+  start = MSEC_NOW();
+  fprintf(ps.out, "P6\n%d %d\n255\n", width, height);
+  if ((i = render(&ps)) != 0 || fclose(ps.out) != 0)
+    {
+      /* The strips are always whole, so generating only fails for memory.
+	 The header promised the whole image, so leave no partial file. */
+      fprintf(stderr, "acidwarp-poster: %s\n",
+	      ps.failed ? "no memory to generate the strips" : "writing failed");
+      if (i != 0)
+	fclose(ps.out);
+      if (stat(out_path, &st) == 0 && S_ISREG(st.st_mode))
+	remove(out_path);	/* not /dev/stdout and the like */
+      exit(1);
+    }
+  ms = MSEC_NOW() - start;
+  fprintf(stderr, "[INFO] %s written in %.1f s, %.1f Mpixels/s\n", out_path, ms / 1000.0,
+	  (double)width * height / (ms * 1000.0));
+  workpool_shutdown();
+  free(ps.line);
+  free(ps.slots);
+  return 0;
+}
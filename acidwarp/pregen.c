@@ -0,0 +1,130 @@
+/* Background generation of the next classic image, see "pregen.h". */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "handy.h"
+#include "generate.h"
+#include "polar.h"
+#include "pregen.h"
+
+/* The slot moves IDLE -> REQUESTED -> RUNNING -> READY -> IDLE. Only the
+ * main thread moves it out of IDLE and READY, and only the worker out of
+ * REQUESTED and RUNNING, so each step is a plain atomic store; the
+ * release/acquire pairs make the params and the finished buffer visible.
+ */
+enum { PREGEN_IDLE, PREGEN_REQUESTED, PREGEN_RUNNING, PREGEN_READY };
+
+static int       pregen_state = PREGEN_IDLE;
+static int       pregen_quit;
+static int       pregen_started;
+static pthread_t pregen_thread;
+static sem_t     pregen_wake;
+
+static GenParams pregen_params;
+static const PolarCache *pregen_pc;	/* set for a morph frame */
+static UCHAR    *pregen_buf;		/* back buffer, the worker's while busy */
+static int       pregen_result;
+static GenStats  pregen_stats;
+
+static int pregen_generate(void)
+{
+  return pregen_pc ? generate_frame(&pregen_params, pregen_pc, pregen_buf) :
+    generate_image_params(&pregen_params, pregen_buf);
+}
+
+static void *pregen_main(void *arg)
+{
+  (void)arg;
+  for (;;)
+    {
+      sem_wait(&pregen_wake);
+      if (__atomic_load_n(&pregen_quit, __ATOMIC_ACQUIRE))
+        break;
+      if (__atomic_load_n(&pregen_state, __ATOMIC_ACQUIRE) != PREGEN_REQUESTED)
+        continue;
+
+      __atomic_store_n(&pregen_state, PREGEN_RUNNING, __ATOMIC_RELAXED);
+      pregen_result = pregen_generate();
+      pregen_stats = gen_last_stats;
+      __atomic_store_n(&pregen_state, PREGEN_READY, __ATOMIC_RELEASE);
+    }
+  return NULL;
+}
+
+int pregen_init(int xmax, int ymax)
+{
+  pregen_buf = (UCHAR *)malloc((size_t)xmax * ymax);
+  if (!pregen_buf)
+    {
+      fprintf(stderr, "Out of memory for the image back buffer.\n");
+      exit(1);
+    }
+
+  if (sem_init(&pregen_wake, 0, 0) == 0 &&
+      pthread_create(&pregen_thread, NULL, pregen_main, NULL) == 0)
+    pregen_started = TRUE;
+  return pregen_started;
+}
+
+void pregen_request(const GenParams *p)
+{
+  pregen_request_frame(p, NULL);
+}
+
+void pregen_request_frame(const GenParams *p, const PolarCache *pc)
+{
+  if (__atomic_load_n(&pregen_state, __ATOMIC_ACQUIRE) != PREGEN_IDLE)
+    return;
+
+  pregen_params = *p;
+  pregen_pc = pc;
+  if (!pregen_started)
+    {
+      /* No thread, so do it now; pregen_take() then just swaps */
+      pregen_result = pregen_generate();
+      pregen_stats = gen_last_stats;
+      pregen_state = PREGEN_READY;
+      return;
+    }
+  __atomic_store_n(&pregen_state, PREGEN_REQUESTED, __ATOMIC_RELEASE);
+  sem_post(&pregen_wake);
+}
+
+int pregen_pending(void)
+{
+  return __atomic_load_n(&pregen_state, __ATOMIC_ACQUIRE) != PREGEN_IDLE;
+}
+
+int pregen_ready(void)
+{
+  return __atomic_load_n(&pregen_state, __ATOMIC_ACQUIRE) == PREGEN_READY;
+}
+
+int pregen_take(UCHAR **buf, GenStats *stats)
+{
+  UCHAR *front = *buf;
+
+  /* A failed image is not swapped in; the one on screen stays */
+  if (pregen_result == 0)
+    {
+      *buf = pregen_buf;
+      pregen_buf = front;
+    }
+  if (stats)
+    *stats = pregen_stats;
+  __atomic_store_n(&pregen_state, PREGEN_IDLE, __ATOMIC_RELEASE);
+  return pregen_result;
+}
+
+/* Waits for an image in progress to finish, then stops the thread */
+void pregen_shutdown(void)
+{
+  if (!pregen_started)
+    return;
+  __atomic_store_n(&pregen_quit, TRUE, __ATOMIC_RELEASE);
+  sem_post(&pregen_wake);
+  pthread_join(pregen_thread, NULL);
+  pregen_started = FALSE;
+}
@@ -0,0 +1,29 @@
+#ifndef PREGEN_H
+#define PREGEN_H
+
+#include "handy.h"
+#include "generate.h"
+#include "polar.h"
+
+/* Generates the next classic image on a background thread while the
+ * current one is on screen. The parameters are drawn by the caller on the
+ * main thread, so --seed still replays a session. Finished images are
+ * handed over by swapping buffer pointers; nothing on the display side
+ * waits on a lock.
+ */
+int  pregen_init(int xmax, int ymax);     /* FALSE: generate in the foreground */
+void pregen_request(const GenParams *p);  /* ignored if a request is pending */
+/* A frame of a moving image through generate_frame() instead; pc must
+ * stay acquired until the frame is taken.
+ */
+void pregen_request_frame(const GenParams *p, const PolarCache *pc);
+int  pregen_pending(void);                /* requested and not yet taken */
+int  pregen_ready(void);
+/* Swaps *buf with the finished image and returns generate_image_params()'s
+ * result; when that is not 0, *buf is left alone. Only call once
+ * pregen_ready() says so.
+ */
+int  pregen_take(UCHAR **buf, GenStats *stats);
+void pregen_shutdown(void);
+
+#endif // PREGEN_H
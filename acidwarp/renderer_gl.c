@@ -7,11 +7,9 @@
 #define PALETTE_SIZE 256
 #define COLOR_CHANNELS 3
 
-// Define global intro palette and buffer for intro rendering
-#define INTRO_WIDTH 320
-#define INTRO_HEIGHT 200
+// Intro palette, cycled while the intro is up
 uint8_t intro_palette[PALETTE_SIZE * COLOR_CHANNELS];
-uint8_t intro_8bit_buf[INTRO_WIDTH * INTRO_HEIGHT];
+void cycle_intro_palette(uint8_t *palette, int frame);
 
 #include "handy.h"
 #include "acidwarp.h"
@@ -21,6 +19,7 @@ uint8_t intro_8bit_buf[INTRO_WIDTH * INTRO_HEIGHT];
 #include <SDL2/SDL_opengl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <unistd.h>
 #include <stdbool.h>
@@ -78,17 +77,18 @@ static GLuint compile_shader(const char *src, GLenum type) {
     return sh;
 }
 
-static GLuint create_program(const char *frag_path) {
-    const char *vs_src = "#version 330 core\nlayout(location=0) in vec2 pos;out vec2 uv;void main(){uv=0.5*pos+0.5;gl_Position=vec4(pos,0,1);}";
+static GLuint link_program(const char *vs_src, const char *fs_src) {
     GLuint vs = compile_shader(vs_src, GL_VERTEX_SHADER);
-    char *fs_src = load_file(frag_path);
-    if (!fs_src) { fprintf(stderr, "Failed to load %s\n", frag_path); return 0; }
     GLuint fs = compile_shader(fs_src, GL_FRAGMENT_SHADER);
-    free(fs_src);
-    if (!vs || !fs) return 0;
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return 0;
+    }
     GLuint prog = glCreateProgram();
     glAttachShader(prog, vs);
     glAttachShader(prog, fs);
+    // Before linking, so "pos" is attribute 0 in shaders without a layout
     glBindAttribLocation(prog, 0, "pos");
     glLinkProgram(prog);
     glDeleteShader(vs); glDeleteShader(fs);
@@ -103,6 +103,145 @@ static GLuint create_program(const char *frag_path) {
     return prog;
 }
 
+static GLuint create_program(const char *frag_path) {
+    const char *vs_src = "#version 330 core\nlayout(location=0) in vec2 pos;out vec2 uv;void main(){uv=0.5*pos+0.5;gl_Position=vec4(pos,0,1);}";
+    char *fs_src = load_file(frag_path);
+    if (!fs_src) { fprintf(stderr, "Failed to load %s\n", frag_path); return 0; }
+    GLuint prog = link_program(vs_src, fs_src);
+    free(fs_src);
+    return prog;
+}
+
+// --- Index image plus palette, looked up on the GPU ---
+// The index image goes up as a one channel texture only when it changes,
+// and per palette tick just the 256x1 palette (768 bytes) goes up; the
+// fragment shader looks every pixel up in it. GLSL 1.20 and GL_R8 (or
+// GL_LUMINANCE8 without GL 3.0 or ARB_texture_rg) so Mesa's llvmpipe runs
+// it as well as real GPUs.
+typedef struct {
+    GLuint program, index_tex, palette_tex, vbo;
+    GLint loc_pos, loc_rect;
+    GLint index_internal;
+    GLenum index_format;
+    int width, height;          // of the index texture, 0 before the first
+} PaletteView;
+
+static const char *palette_vs_src =
+    "#version 120\n"
+    "attribute vec2 pos;\n"
+    "uniform vec4 u_rect;\n"   // x0, y0, x1, y1 of the image in clip space
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    vec2 t = 0.5 * pos + 0.5;\n"
+    "    uv = vec2(t.x, 1.0 - t.y);\n"
+    "    gl_Position = vec4(mix(u_rect.xy, u_rect.zw, t), 0.0, 1.0);\n"
+    "}\n";
+
+static const char *palette_fs_src =
+    "#version 120\n"
+    "uniform sampler2D u_indices;\n"
+    "uniform sampler2D u_palette;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    float i = texture2D(u_indices, uv).r * 255.0;\n"
+    "    gl_FragColor = vec4(texture2D(u_palette, vec2((i + 0.5) / 256.0, 0.5)).rgb, 1.0);\n"
+    "}\n";
+
+static GLuint nearest_texture(void) {
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+
+static int palette_view_init(PaletteView *v) {
+    static const float quad[8] = {-1,-1, 1,-1, 1,1, -1,1};
+
+    memset(v, 0, sizeof(*v));
+    v->program = link_program(palette_vs_src, palette_fs_src);
+    if (!v->program)
+        return 0;
+    glUseProgram(v->program);
+    glUniform1i(glGetUniformLocation(v->program, "u_indices"), 0);
+    glUniform1i(glGetUniformLocation(v->program, "u_palette"), 1);
+    v->loc_rect = glGetUniformLocation(v->program, "u_rect");
+    glUseProgram(0);
+    // Read back rather than assumed, in case the driver placed it elsewhere
+    v->loc_pos = glGetAttribLocation(v->program, "pos");
+    if (v->loc_pos < 0) {
+        fprintf(stderr, "Palette shader has no pos attribute\n");
+        glDeleteProgram(v->program);
+        v->program = 0;
+        return 0;
+    }
+
+    if (GLEW_VERSION_3_0 || GLEW_ARB_texture_rg) {
+        v->index_internal = GL_R8;
+        v->index_format = GL_RED;
+    } else {
+        v->index_internal = GL_LUMINANCE8;
+        v->index_format = GL_LUMINANCE;
+    }
+    v->index_tex = nearest_texture();
+    v->palette_tex = nearest_texture();
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, PALETTE_SIZE, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glGenBuffers(1, &v->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, v->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return 1;
+}
+
+static void palette_view_set_image(PaletteView *v, const uint8_t *indices, int width, int height) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, v->index_tex);
+    if (width != v->width || height != v->height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, v->index_internal, width, height, 0,
+                     v->index_format, GL_UNSIGNED_BYTE, indices);
+        v->width = width;
+        v->height = height;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, v->index_format, GL_UNSIGNED_BYTE, indices);
+    }
+}
+
+// Draws the image into the clip space rectangle (x0, y0)-(x1, y1) through
+// a 6 bit VGA palette, scaled to 8 bits the way convert_8bit_to_32bit() does
+static void palette_view_draw(PaletteView *v, const uint8_t *palette, float x0, float y0, float x1, float y1) {
+    uint8_t rgb[PALETTE_SIZE * COLOR_CHANNELS];
+
+    for (int i = 0; i < PALETTE_SIZE * COLOR_CHANNELS; ++i)
+        rgb[i] = (uint8_t)((palette[i] << 2) | (palette[i] >> 4));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, v->palette_tex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PALETTE_SIZE, 1, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, v->index_tex);
+
+    glUseProgram(v->program);
+    glUniform4f(v->loc_rect, x0, y0, x1, y1);
+    glBindBuffer(GL_ARRAY_BUFFER, v->vbo);
+    glEnableVertexAttribArray(v->loc_pos);
+    glVertexAttribPointer(v->loc_pos, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    glDisableVertexAttribArray(v->loc_pos);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
+
+static void palette_view_free(PaletteView *v) {
+    if (v->program) glDeleteProgram(v->program);
+    if (v->index_tex) glDeleteTextures(1, &v->index_tex);
+    if (v->palette_tex) glDeleteTextures(1, &v->palette_tex);
+    if (v->vbo) glDeleteBuffers(1, &v->vbo);
+    memset(v, 0, sizeof(*v));
+}
+
 // Helper: Mandelbrot iteration count for a point
 int mandelbrot_iter(double x, double y, int max_iter) {
     double zx = 0, zy = 0;
@@ -316,17 +455,15 @@ static void renderer_gl_present_julia_shader(float time_s) {
     SDL_GL_SwapWindow(gl_window);
 }
 
-// Display an animated RGBA buffer (classic intro) as a fullscreen OpenGL texture for a given duration (ms)
-void renderer_gl_show_intro_texture(const uint32_t *rgba_buffer, int width, int height, int display_ms) {
-    // We'll need to animate the palette, so accept the 8-bit buffer and palette
-    extern void cycle_intro_palette(uint8_t *palette, int frame); // We'll define this below
-    extern void convert_8bit_to_32bit(const uint8_t *buffer, uint32_t *out_rgba, int width, int height, const uint8_t *palette);
-    uint32_t *frame_rgba = (uint32_t*)malloc(width * height * sizeof(uint32_t));
-    GLuint tex = 0;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Display the classic intro (an index image and its palette) fullscreen for a given duration (ms)
+void renderer_gl_show_intro(const uint8_t *indices, const uint8_t *palette, int width, int height, int display_ms) {
+    PaletteView view;
+    if (!palette_view_init(&view)) {
+        fprintf(stderr, "Failed to set up the intro palette shader.\n");
+        return;
+    }
+    memcpy(intro_palette, palette, sizeof(intro_palette));
+    palette_view_set_image(&view, indices, width, height);
 
     Uint32 start = SDL_GetTicks();
     SDL_Event event;
@@ -337,21 +474,12 @@ void renderer_gl_show_intro_texture(const uint32_t *rgba_buffer, int width, int
             if (event.type == SDL_QUIT) running = 0;
             if (event.type == SDL_KEYDOWN) running = 0;
         }
-        // Animate palette
+        // Animate palette; only it goes to the GPU each frame
         cycle_intro_palette(intro_palette, frame);
-        convert_8bit_to_32bit(intro_8bit_buf, frame_rgba, width, height, intro_palette);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame_rgba);
 
         glViewport(0, 0, gl_width, gl_height);
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
         glClearColor(0, 0, 0, 1);
         glClear(GL_COLOR_BUFFER_BIT);
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, tex);
         // Compute aspect-correct quad
         float window_aspect = (float)gl_width / (float)gl_height;
         float image_aspect = (float)width / (float)height;
@@ -365,18 +493,12 @@ void renderer_gl_show_intro_texture(const uint32_t *rgba_buffer, int width, int
             float h = height * scale / gl_height;
             x0 = -1; x1 = 1; y0 = -h; y1 = h;
         }
-        glBegin(GL_QUADS);
-            glTexCoord2f(0, 1); glVertex2f(x0, y0);
-            glTexCoord2f(1, 1); glVertex2f(x1, y0);
-            glTexCoord2f(1, 0); glVertex2f(x1, y1);
-            glTexCoord2f(0, 0); glVertex2f(x0, y1);
-        glEnd();
+        palette_view_draw(&view, intro_palette, x0, y0, x1, y1);
         SDL_GL_SwapWindow(gl_window);
         SDL_Delay(16);
         frame++;
     }
-    glDeleteTextures(1, &tex);
-    free(frame_rgba);
+    palette_view_free(&view);
 }
 
 // Dummy palette cycling for now (replace with real logic)
@@ -390,6 +512,54 @@ void cycle_intro_palette(uint8_t *palette, int frame) {
     }
 }
 
+// --- The classic player through GL (--renderer=gl-classic) ---
+// On the player's own window, in place of the SDL renderer and its ARGB
+// streaming texture.
+static SDL_Window *classic_window = NULL;
+static SDL_GLContext classic_context = NULL;
+static PaletteView classic_view;
+
+int renderer_gl_classic_init(SDL_Window *window) {
+    classic_context = SDL_GL_CreateContext(window);
+    if (!classic_context) {
+        fprintf(stderr, "SDL_GL_CreateContext failed: %s\n", SDL_GetError());
+        return 0;
+    }
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK || !GLEW_VERSION_2_1 || !palette_view_init(&classic_view)) {
+        fprintf(stderr, "OpenGL 2.1 with GLSL 1.20 is needed for --renderer=gl-classic\n");
+        SDL_GL_DeleteContext(classic_context);
+        classic_context = NULL;
+        return 0;
+    }
+    SDL_GL_SetSwapInterval(1); // vsync
+    classic_window = window;
+    printf("[INFO] gl-classic: %s, %s index texture\n", (const char *)glGetString(GL_RENDERER),
+           classic_view.index_internal == GL_R8 ? "R8" : "LUMINANCE8");
+    return 1;
+}
+
+void renderer_gl_classic_set_image(const uint8_t *indices, int width, int height) {
+    palette_view_set_image(&classic_view, indices, width, height);
+}
+
+void renderer_gl_classic_present(const uint8_t *palette) {
+    int w, h;
+
+    SDL_GL_GetDrawableSize(classic_window, &w, &h);
+    glViewport(0, 0, w, h);
+    palette_view_draw(&classic_view, palette, -1, -1, 1, 1);
+    SDL_GL_SwapWindow(classic_window);
+}
+
+void renderer_gl_classic_cleanup(void) {
+    if (!classic_context)
+        return;
+    palette_view_free(&classic_view);
+    SDL_GL_DeleteContext(classic_context);
+    classic_context = NULL;
+}
+
 void renderer_gl_cleanup() {
     if (gl_rgb_buffer) free(gl_rgb_buffer);
     if (gl_texture) glDeleteTextures(1, &gl_texture);
@@ -436,7 +606,7 @@ void renderer_gl_mainloop() {
             // Pick a new random effect, not the same as current
             int next_effect;
             do {
-                next_effect = rand() % rgb_effect_count;
+                next_effect = RANDOM(rgb_effect_count);
             } while (next_effect == prev_effect && rgb_effect_count > 1);
             selected_effect = next_effect;
 #ifdef DEBUG
@@ -1,6 +1,10 @@
 #ifndef RENDERER_GL_H
 #define RENDERER_GL_H
 
+#include <stdint.h>
+
+struct SDL_Window;
+
 typedef struct {
     int width, height;
 } RendererGLConfig;
@@ -12,6 +16,14 @@ void renderer_gl_fill_modern_effect();
 void renderer_gl_present();
 void renderer_gl_mainloop();
 void renderer_gl_cleanup();
-void renderer_gl_show_intro_texture(const uint32_t *rgba_buffer, int width, int height, int display_ms);
+void renderer_gl_show_intro(const uint8_t *indices, const uint8_t *palette, int width, int height, int display_ms);
+
+// The classic player through GL (--renderer=gl-classic): the index image
+// lives on the GPU and each tick uploads only the palette. On the
+// player's window, made with SDL_WINDOW_OPENGL; 0 if GL is not up to it.
+int renderer_gl_classic_init(struct SDL_Window *window);
+void renderer_gl_classic_set_image(const uint8_t *indices, int width, int height);
+void renderer_gl_classic_present(const uint8_t *palette);
+void renderer_gl_classic_cleanup(void);
 
 #endif // RENDERER_GL_H
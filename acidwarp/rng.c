@@ -0,0 +1,44 @@
+/* Explicit-state random number streams, see "rng.h". */
+#include "rng.h"
+
+Rng rng_session;
+static uint64_t session_seed;
+
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/* Different stream numbers give unrelated sequences from the same seed */
+void rng_seed(Rng *r, uint64_t seed, uint64_t stream)
+{
+  uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+  uint64_t a = splitmix64(&x), b = splitmix64(&x);
+
+  r->s[0] = (uint32_t)a;  r->s[1] = (uint32_t)(a >> 32);
+  r->s[2] = (uint32_t)b;  r->s[3] = (uint32_t)(b >> 32);
+  if (!(r->s[0] | r->s[1] | r->s[2] | r->s[3]))
+    r->s[0] = 1;		/* the one state xoshiro cannot leave */
+}
+
+void rng_split(Rng *parent, Rng *child)
+{
+  uint64_t hi = rng_next(parent), lo = rng_next(parent);
+
+  rng_seed(child, (hi << 32) | lo, 0);
+}
+
+void rng_session_seed(uint64_t seed)
+{
+  session_seed = seed;
+  rng_seed(&rng_session, seed, 0);
+}
+
+uint64_t rng_session_seed_value(void)
+{
+  return session_seed;
+}
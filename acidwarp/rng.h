@@ -0,0 +1,53 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* Small explicit-state random number generator (xoshiro128**).
+ *
+ * Each Rng is owned by one thread at a time, so nothing here takes a lock.
+ * rng_session is the main thread's stream behind RANDOM(); generator work
+ * that runs on other threads gets its own stream, split off the session
+ * stream or seeded with rng_seed() and a stream number. The same session
+ * seed (--seed) replays the same pictures and palettes.
+ */
+typedef struct {
+  uint32_t s[4];
+} Rng;
+
+extern Rng rng_session;
+
+void     rng_seed(Rng *r, uint64_t seed, uint64_t stream);
+void     rng_split(Rng *parent, Rng *child);
+void     rng_session_seed(uint64_t seed);
+uint64_t rng_session_seed_value(void);
+
+static inline uint32_t rng_rotl(uint32_t x, int k)
+{
+  return (x << k) | (x >> (32 - k));
+}
+
+static inline uint32_t rng_next(Rng *r)
+{
+  uint32_t *s = r->s;
+  uint32_t result = rng_rotl(s[1] * 5, 7) * 9;
+  uint32_t t = s[1] << 9;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 11);
+  return result;
+}
+
+/* 0 <= result < n, for n > 0. Multiply and shift rather than %, which
+ * costs a divide.
+ */
+static inline int rng_below(Rng *r, int n)
+{
+  return (int)(((uint64_t)rng_next(r) * (uint32_t)n) >> 32);
+}
+
+#endif // RNG_H
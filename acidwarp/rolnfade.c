@@ -44,14 +44,50 @@ void rotateforward(int color, UCHAR *Pal)
 }
 
 
-void rollMainPalArrayAndLoadDACRegs(UCHAR *MainPalArray)
+/* Entries 1-255 of a channel roll, entry 0 stays put */
+#define RING_ENTRIES 255
+
+void palring_load(PalRing *ring, const UCHAR *palArray)
+{
+  memcpy(ring->base, palArray, sizeof(ring->base));
+  ring->offset[RED] = ring->offset[GREEN] = ring->offset[BLUE] = 0;
+  ring->view_valid = FALSE;
+}
+
+/* The palette as byte for byte rotateforward()/rotatebackward() would
+   have left it; made again only after the ring changed */
+const UCHAR *palring_colors(PalRing *ring)
+{
+  int color, x, split;
+
+  if (ring->view_valid)
+    return ring->view;
+  for (color = 0; color < 3; ++color)
+    {
+      const UCHAR *base = ring->base + 3 + color;
+      UCHAR *view = ring->view + 3 + color;
+
+      /* entries 1 .. 255-offset come from base 1+offset on, the rest
+         from base 1 on */
+      split = RING_ENTRIES - ring->offset[color];
+      for (x = 0; x < split; ++x)
+        view[x * 3] = base[(x + ring->offset[color]) * 3];
+      for (; x < RING_ENTRIES; ++x)
+        view[x * 3] = base[(x - split) * 3];
+      ring->view[color] = ring->base[color];
+    }
+  ring->view_valid = TRUE;
+  return ring->view;
+}
+
+void rollMainPalArrayAndLoadDACRegs(PalRing *MainPalArray)
 {
     maybeInvertSubPalRollDirection();
-    roll_rgb_palArray(MainPalArray);
+    roll_rgb_palRing(MainPalArray);
 }
 
 
-void rolNFadeWhtMainPalArrayNLoadDAC(UCHAR *MainPalArray)
+void rolNFadeWhtMainPalArrayNLoadDAC(PalRing *MainPalArray)
 {
     if (!FadeCompleteFlag)
     {
@@ -61,7 +97,7 @@ void rolNFadeWhtMainPalArrayNLoadDAC(UCHAR *MainPalArray)
     }
 }
 
-void rolNFadeBlkMainPalArrayNLoadDAC(UCHAR *MainPalArray)
+void rolNFadeBlkMainPalArrayNLoadDAC(PalRing *MainPalArray)
 {
     if (!FadeCompleteFlag)
     {
@@ -71,7 +107,7 @@ void rolNFadeBlkMainPalArrayNLoadDAC(UCHAR *MainPalArray)
     }
 }
 
-void rolNFadeMainPalAryToTargNLodDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray)
+void rolNFadeMainPalAryToTargNLodDAC(PalRing *MainPalArray, PalRing *TargetPalArray)
 {
     if (!FadeCompleteFlag)
     {
@@ -79,8 +115,8 @@ void rolNFadeMainPalAryToTargNLodDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray)
             FadeCompleteFlag = 1;
 
         maybeInvertSubPalRollDirection();
-        roll_rgb_palArray (  MainPalArray);
-        roll_rgb_palArray (TargetPalArray);
+        roll_rgb_palRing (  MainPalArray);
+        roll_rgb_palRing (TargetPalArray);
     }
     else
         rollMainPalArrayAndLoadDACRegs(MainPalArray);
@@ -92,14 +128,19 @@ void rolNFadeMainPalAryToTargNLodDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray)
    The effect is quite interesting.
 */
 
-void rolNFadMainPalAry2RndTargNLdDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray)
+void rolNFadMainPalAry2RndTargNLdDAC(PalRing *MainPalArray, PalRing *TargetPalArray)
 {
 	if (fadePalArrayToTarget (MainPalArray, TargetPalArray) == DONE)
-         initPalArray (TargetPalArray, RANDOM (NUM_PALETTE_TYPES));
+	{
+	 UCHAR palArray[256 * 3];
+
+         initPalArray (palArray, RANDOM (NUM_PALETTE_TYPES));
+	 palring_load (TargetPalArray, palArray);
+	}
 
 	maybeInvertSubPalRollDirection();
-	roll_rgb_palArray (  MainPalArray);
-	roll_rgb_palArray (TargetPalArray);
+	roll_rgb_palRing (  MainPalArray);
+	roll_rgb_palRing (TargetPalArray);
     // TODO: Update SDL2 palette here
 }
 
@@ -107,11 +148,14 @@ void rolNFadMainPalAry2RndTargNLdDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray)
 
 /* These routines do the actual fading of a palette array to white, black,
 	or to the values of another ("target") palette array.
+	Fading to white or black treats every entry alike, so it is done
+	on the unrotated bytes.
 */
 
-int fadePalArrayToWhite (UCHAR *MainpalArray)
+int fadePalArrayToWhite (PalRing *MainpalArray)
 {
-    UCHAR *palArray = MainpalArray;
+    UCHAR *palArray = MainpalArray->base;
+    MainpalArray->view_valid = FALSE;
     int palByteNum, num_white = 0;
     for (palByteNum = 3; palByteNum < 768; ++palByteNum)
     {
@@ -123,9 +167,10 @@ int fadePalArrayToWhite (UCHAR *MainpalArray)
     return ((num_white >= 765) ? DONE : NOT_DONE);
 }
 
-int fadePalArrayToBlack (UCHAR *MainpalArray)
+int fadePalArrayToBlack (PalRing *MainpalArray)
 {
-    UCHAR *palArray = MainpalArray;
+    UCHAR *palArray = MainpalArray->base;
+    MainpalArray->view_valid = FALSE;
     int palByteNum, num_black = 0;
     for (palByteNum = 3; palByteNum < 768; ++palByteNum)
     {
@@ -137,21 +182,118 @@ int fadePalArrayToBlack (UCHAR *MainpalArray)
     return ((num_black >= 765) ? DONE : NOT_DONE);
 }
 
-int fadePalArrayToTarget (UCHAR *palArrayBeingChanged, const UCHAR *targetPalArray)
+/* Each entry goes towards the target entry shown in the same place. Base
+   entry j of a channel shows where target base entry j + the difference
+   of the offsets does. */
+int fadePalArrayToTarget (PalRing *palArrayBeingChanged, const PalRing *targetPalArray)
 {
-    int palByteNum, num_equal = 0;
-    for (palByteNum = 3; palByteNum < 768; ++palByteNum)
+    int color, j, t, num_equal = 0;
+    for (color = 0; color < 3; ++color)
     {
-        if   (palArrayBeingChanged[palByteNum] < targetPalArray[palByteNum])
-             ++palArrayBeingChanged[palByteNum];
-        else if (palArrayBeingChanged[palByteNum] > targetPalArray[palByteNum])
-             --palArrayBeingChanged[palByteNum];
-        else
-            ++num_equal;
+        UCHAR *pal = palArrayBeingChanged->base + 3 + color;
+        const UCHAR *target = targetPalArray->base + 3 + color;
+
+        t = (targetPalArray->offset[color] - palArrayBeingChanged->offset[color] + RING_ENTRIES) % RING_ENTRIES;
+        for (j = 0; j < RING_ENTRIES; ++j, t = (t + 1 == RING_ENTRIES) ? 0 : t + 1)
+        {
+            if   (pal[j * 3] < target[t * 3])
+                 ++pal[j * 3];
+            else if (pal[j * 3] > target[t * 3])
+                 --pal[j * 3];
+            else
+                ++num_equal;
+        }
     }
+    palArrayBeingChanged->view_valid = FALSE;
     return ((num_equal >= 765) ? DONE : NOT_DONE);
 }
 
+/* The target of a fade is taken as it is shown when the fade begins,
+   put in the order of the ring's base; the two roll together from then
+   on, so that stays right for the whole fade. */
+void palfade_begin(PalFade *fade, const PalRing *ring, FadeKind kind, const PalRing *target)
+{
+  int color, j, t, byte, distance;
+
+  memcpy(fade->from, ring->base, sizeof(fade->from));
+  memcpy(fade->to, ring->base, 3);	/* entry 0 does not fade */
+  for (color = 0; color < 3; ++color)
+    {
+      t = (kind == FADE_TO_TARGET) ?
+          (target->offset[color] - ring->offset[color] + RING_ENTRIES) % RING_ENTRIES : 0;
+      for (j = 0; j < RING_ENTRIES; ++j, t = (t + 1 == RING_ENTRIES) ? 0 : t + 1)
+        {
+          byte = 3 + j * 3 + color;
+          if (kind == FADE_TO_TARGET)
+            fade->to[byte] = target->base[3 + t * 3 + color];
+          else if (kind == FADE_TO_WHITE)
+            fade->to[byte] = MAX(fade->from[byte], 63);	/* brighter ones stay */
+          else
+            fade->to[byte] = 0;
+        }
+    }
+  fade->length = 0;
+  for (byte = 3; byte < 768; ++byte)
+    {
+      distance = abs(fade->to[byte] - fade->from[byte]);
+      fade->length = MAX(fade->length, distance);
+    }
+}
+
+/* The ring as the fade leaves it after ticks ticks; DONE from the tick
+   after the last byte arrived, like the fadePalArrayTo...() calls */
+int palfade_seek(const PalFade *fade, PalRing *ring, long ticks)
+{
+  int byte, from, to;
+
+  for (byte = 3; byte < 768; ++byte)
+    {
+      from = fade->from[byte];
+      to = fade->to[byte];
+      if (to > from)
+        ring->base[byte] = (UCHAR)((to - from <= ticks) ? to : from + ticks);
+      else
+        ring->base[byte] = (UCHAR)((from - to <= ticks) ? to : from - ticks);
+    }
+  ring->view_valid = FALSE;
+  return ((ticks > fade->length) ? DONE : NOT_DONE);
+}
+
+/* ticks ticks of rollMainPalArrayAndLoadDACRegs(), on target as well
+   unless it is NULL */
+void roll_rgb_palRings(PalRing *ring, PalRing *target, long ticks)
+{
+  long turn[3] = { 0, 0, 0 };
+  int color;
+
+  for (; ticks > 0; --ticks)
+    {
+      maybeInvertSubPalRollDirection();
+      turn[RED] += RedRollDirection ? RING_ENTRIES - 1 : 1;
+      turn[GREEN] += GrnRollDirection ? RING_ENTRIES - 1 : 1;
+      turn[BLUE] += BluRollDirection ? RING_ENTRIES - 1 : 1;
+    }
+  for (color = 0; color < 3; ++color)
+    {
+      ring->offset[color] = (int)((ring->offset[color] + turn[color]) % RING_ENTRIES);
+      if (target)
+        target->offset[color] = (int)((target->offset[color] + turn[color]) % RING_ENTRIES);
+    }
+  ring->view_valid = FALSE;
+  if (target)
+    target->view_valid = FALSE;
+}
+
+/* A forward roll moves every entry down one, so the offset goes up */
+void roll_rgb_palRing(PalRing *ring)
+{
+    ring->offset[RED] = (ring->offset[RED] + (RedRollDirection ? RING_ENTRIES - 1 : 1)) % RING_ENTRIES;
+    ring->offset[GREEN] = (ring->offset[GREEN] + (GrnRollDirection ? RING_ENTRIES - 1 : 1)) % RING_ENTRIES;
+    ring->offset[BLUE] = (ring->offset[BLUE] + (BluRollDirection ? RING_ENTRIES - 1 : 1)) % RING_ENTRIES;
+    ring->view_valid = FALSE;
+}
+
+/* The same on a plain palette array, moving the bytes */
 void roll_rgb_palArray(UCHAR *Pal)
 {
     if (!RedRollDirection)
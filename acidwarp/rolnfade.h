@@ -1,10 +1,50 @@
-void rollMainPalArrayAndLoadDACRegs(UCHAR *MainPalArray);
-void rolNFadeWhtMainPalArrayNLoadDAC(UCHAR *MainPalArray);
-void rolNFadeBlkMainPalArrayNLoadDAC(UCHAR *MainPalArray);
-void rolNFadeMainPalAryToTargNLodDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray);
-void rolNFadMainPalAry2RndTargNLdDAC(UCHAR *MainPalArray, UCHAR *TargetPalArray);
+#ifndef ROLNFADE_H
+#define ROLNFADE_H
+
+/* A palette as it is rolled: entries 1-255 of each channel turn round
+ * separately, entry 0 stays put. The bytes never move; a roll only
+ * turns the channel's offset into the unrotated base, and the palette
+ * as it looks is put together when palring_colors() asks for it.
+ */
+typedef struct {
+  UCHAR base[256 * 3];		/* unrotated */
+  UCHAR view[256 * 3];		/* base rolled by offset, see palring_colors() */
+  int   offset[3];		/* entry x of a channel is base entry 1 + (x-1 + offset) % 255 */
+  int   view_valid;
+} PalRing;
+
+void palring_load(PalRing *ring, const UCHAR *palArray);
+const UCHAR *palring_colors(PalRing *ring);
+
+/* Fades as a function of time. A fade moves every byte one step a tick
+ * towards where it ends up, so after t ticks each byte is its value at
+ * the start moved by up to t; palfade_seek() puts a ring at any tick of
+ * a fade at once, however many ticks were skipped. Rolling by t ticks
+ * turns the offsets once, after drawing the direction changes for each
+ * of the t ticks.
+ */
+typedef enum { FADE_TO_WHITE, FADE_TO_BLACK, FADE_TO_TARGET } FadeKind;
+
+typedef struct {
+  UCHAR from[256 * 3];		/* the ring's base when the fade began */
+  UCHAR to[256 * 3];		/* and where each byte of it ends up */
+  long  length;			/* ticks until the last byte gets there */
+} PalFade;
+
+void palfade_begin(PalFade *fade, const PalRing *ring, FadeKind kind, const PalRing *target);
+int palfade_seek(const PalFade *fade, PalRing *ring, long ticks);
+void roll_rgb_palRings(PalRing *ring, PalRing *target, long ticks);
+
+void rollMainPalArrayAndLoadDACRegs(PalRing *MainPalArray);
+void rolNFadeWhtMainPalArrayNLoadDAC(PalRing *MainPalArray);
+void rolNFadeBlkMainPalArrayNLoadDAC(PalRing *MainPalArray);
+void rolNFadeMainPalAryToTargNLodDAC(PalRing *MainPalArray, PalRing *TargetPalArray);
+void rolNFadMainPalAry2RndTargNLdDAC(PalRing *MainPalArray, PalRing *TargetPalArray);
+void roll_rgb_palRing (PalRing *ring);
 void roll_rgb_palArray (UCHAR *MainpalArray);
 void maybeInvertSubPalRollDirection(void);
-int fadePalArrayToWhite (UCHAR *MainpalArray);
-int fadePalArrayToBlack (UCHAR *MainpalArray);
-int fadePalArrayToTarget (UCHAR *palArrayBeingChanged, const UCHAR *targetPalArray);
+int fadePalArrayToWhite (PalRing *MainpalArray);
+int fadePalArrayToBlack (PalRing *MainpalArray);
+int fadePalArrayToTarget (PalRing *palArrayBeingChanged, const PalRing *targetPalArray);
+
+#endif /* ROLNFADE_H */
@@ -0,0 +1,700 @@
+/* Pattern expressions loaded at run time, see userpat.h */
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "handy.h"
+#include "lut.h"
+#include "userpat.h"
+
+#define USERPAT_LANES  256	/* pixels each vector instruction works on */
+#define USERPAT_REGS   16	/* vector registers */
+#define USERPAT_SLOTS  128	/* scalars worked out once per row */
+#define USERPAT_CODE   128	/* instructions in each program */
+#define USERPAT_NODES  256
+#define USERPAT_LINE   1024
+#define USERPAT_NAME   64
+
+/* Names an expression can use. The first four change along a row, the
+ * rest are the same for a whole row.
+ */
+enum {
+  VAR_X, VAR_DX, VAR_DIST, VAR_ANGLE,
+  VAR_Y, VAR_DY, VAR_XMAX, VAR_YMAX,
+  VAR_X1, VAR_X2, VAR_X3, VAR_X4,
+  VAR_Y1, VAR_Y2, VAR_Y3, VAR_Y4,
+  VAR_A1, VAR_A2, VAR_A3, VAR_A4,
+  NUM_VARS
+};
+#define VAR_VARYING(v)  ((v) <= VAR_ANGLE)
+
+static const char *const var_names[NUM_VARS] =
+{
+  "x", "dx", "dist", "angle", "y", "dy", "xmax", "ymax",
+  "x1", "x2", "x3", "x4", "y1", "y2", "y3", "y4", "a1", "a2", "a3", "a4",
+};
+
+/* Operators, each with what it does to one pair of 32 bit values.
+ * Overflow wraps and dividing by zero gives zero, so no expression can
+ * take the program down.
+ */
+/* Through a double, which holds every int32_t quotient exactly, and with
+ * no branches, so the vector loops still vectorize. The only quotient
+ * that does not fit, INT32_MIN / -1, saturates.
+ */
+static inline int32_t div_op(int32_t a, int32_t b)
+{
+  const double q = (double)a / (b | (b == 0));
+
+  return (int32_t)MIN(q, 2147483647.0) & -(int32_t)(b != 0);
+}
+
+#define BINARY_OPS(X)							\
+  X(ADD, (int32_t)((uint32_t)a + (uint32_t)b))				\
+  X(SUB, (int32_t)((uint32_t)a - (uint32_t)b))				\
+  X(MUL, (int32_t)((uint32_t)a * (uint32_t)b))				\
+  X(DIV, div_op (a, b))							\
+  X(MOD, (int32_t)((uint32_t)a - (uint32_t)div_op (a, b) * (uint32_t)b)	\
+	 & -(int32_t)((uint32_t)b + 1u > 1u))				\
+  X(SHL, (int32_t)((uint32_t)a << (b & 31)))				\
+  X(SHR, a >> (b & 31))							\
+  X(AND, a & b)								\
+  X(XOR, a ^ b)								\
+  X(OR,  a | b)
+
+#define UNARY_OPS(X)							\
+  X(NEG, (int32_t)(0u - (uint32_t)a))					\
+  X(NOT, ~a)								\
+  X(ABS, (a < 0) ? (int32_t)(0u - (uint32_t)a) : a)			\
+  X(SIN, (int32_t)lut_sin (a))						\
+  X(COS, (int32_t)lut_sin ((int32_t)((uint32_t)a + ANGLE_UNIT_QUART)))
+
+enum {
+  OP_CONST, OP_VAR,
+#define X(name, expr) OP_##name,
+  BINARY_OPS(X)
+  UNARY_OPS(X)
+#undef X
+};
+#define IS_BINARY(op)  ((op) >= OP_ADD && (op) <= OP_OR)
+
+#define X(name, expr)							\
+  static inline int32_t op_##name(int32_t a, int32_t b)			\
+  {									\
+    (void)b;								\
+    return (expr);							\
+  }
+BINARY_OPS(X)
+UNARY_OPS(X)
+#undef X
+
+/* Where the operands of a vector instruction live: V is a register, U a
+ * per row scalar.
+ */
+enum { FORM_VV, FORM_VU, FORM_UV };
+
+typedef struct {
+  uint8_t op, form;
+  uint8_t dst, a, b;		/* registers or slots */
+  int32_t k;			/* OP_CONST value, OP_VAR name */
+} Insn;
+
+struct UserPattern {
+  char name[USERPAT_NAME];
+  int uses;
+  int varying;			/* FALSE: the same color along each row */
+  int result;			/* register, or slot if not varying */
+  int nrow, nvec, nslots;
+  Insn row[USERPAT_CODE];	/* once per row, into slots */
+  Insn vec[USERPAT_CODE];	/* once per USERPAT_LANES pixels */
+};
+
+static UserPattern *patterns[USERPAT_MAX];
+static int npatterns = 0;
+
+
+/* Compiling. The expression is parsed into a tree, then every part that
+ * does not change along a row goes into the row program and the rest into
+ * the vector program, which reads those parts as scalars.
+ */
+typedef struct {
+  int op, a, b;
+  int32_t k;
+  int varying;
+  int regs;			/* vector registers emit_vec() needs for it */
+} Node;
+
+typedef struct {
+  const char *s;		/* next character */
+  const char *err;		/* the first error, if any */
+  Node node[USERPAT_NODES];
+  int nnodes;
+  unsigned regs;		/* registers in use */
+  UserPattern *up;
+} Compiler;
+
+static int fail(Compiler *c, const char *err)
+{
+  if (!c->err)
+    c->err = err;
+  return -1;
+}
+
+static void skip_space(Compiler *c)
+{
+  while (isspace((unsigned char)*c->s))
+    ++c->s;
+}
+
+/* Sethi-Ullman: with the needier operand made first, its result is held
+ * only while the other one is made, and the destination is taken while
+ * both sources are still held. Parts that do not vary need none.
+ */
+static int node_regs(const Compiler *c, const Node *n)
+{
+  int ra, rb;
+
+  if (!n->varying)
+    return 0;
+  if (n->op == OP_VAR)
+    return 1;
+  ra = c->node[n->a].regs;
+  rb = (n->b >= 0) ? c->node[n->b].regs : 0;
+  if (ra && rb)
+    return MAX(MAX(ra, rb), MAX(MIN(ra, rb) + 1, 3));
+  return MAX(ra + rb, 2);
+}
+
+static int new_node(Compiler *c, int op, int a, int b, int32_t k)
+{
+  Node *n;
+
+  if (c->err)
+    return -1;
+  if (c->nnodes == USERPAT_NODES)
+    return fail(c, "expression too long");
+  n = &c->node[c->nnodes];
+  n->op = op;  n->a = a;  n->b = b;  n->k = k;
+  if (op == OP_VAR)
+    n->varying = VAR_VARYING(k);
+  else
+    n->varying = (a >= 0 && c->node[a].varying) || (b >= 0 && c->node[b].varying);
+  n->regs = node_regs(c, n);
+  return c->nnodes++;
+}
+
+static int parse_binary(Compiler *c, int level);
+
+static const struct {
+  const char *tok;
+  int op, level;
+} binary_ops[] =
+{
+  { "|", OP_OR, 0 },   { "^", OP_XOR, 1 },  { "&", OP_AND, 2 },
+  { "<<", OP_SHL, 3 }, { ">>", OP_SHR, 3 },
+  { "+", OP_ADD, 4 },  { "-", OP_SUB, 4 },
+  { "*", OP_MUL, 5 },  { "/", OP_DIV, 5 },  { "%", OP_MOD, 5 },
+};
+#define NUM_BINARY_OPS  ((int)(sizeof(binary_ops) / sizeof(binary_ops[0])))
+#define TOP_LEVEL       5
+
+static int parse_call(Compiler *c, int op)
+{
+  int arg;
+
+  skip_space(c);
+  if (*c->s != '(')
+    return fail(c, "expected '('");
+  ++c->s;
+  arg = parse_binary(c, 0);
+  skip_space(c);
+  if (*c->s != ')')
+    return fail(c, "expected ')'");
+  ++c->s;
+  return new_node(c, op, arg, -1, 0);
+}
+
+static int parse_unary(Compiler *c)
+{
+  char name[32], *end;
+  const char *start;
+  long value;
+  int i, n;
+
+  skip_space(c);
+  switch (*c->s)
+    {
+    case '-':
+      ++c->s;
+      return new_node(c, OP_NEG, parse_unary(c), -1, 0);
+    case '~':
+      ++c->s;
+      return new_node(c, OP_NOT, parse_unary(c), -1, 0);
+    case '+':
+      ++c->s;
+      return parse_unary(c);
+    case '(':
+      ++c->s;
+      n = parse_binary(c, 0);
+      skip_space(c);
+      if (*c->s != ')')
+	return fail(c, "expected ')'");
+      ++c->s;
+      return n;
+    }
+
+  if (isdigit((unsigned char)*c->s))
+    {
+      errno = 0;
+      value = strtol(c->s, &end, 0);
+      c->s = end;
+      if (errno || value > INT32_MAX)
+	return fail(c, "number out of range");
+      return new_node(c, OP_CONST, -1, -1, (int32_t)value);
+    }
+
+  start = c->s;
+  while (isalnum((unsigned char)*c->s) || *c->s == '_')
+    ++c->s;
+  n = (int)(c->s - start);
+  if (n == 0)
+    return fail(c, "expected a number, name or '('");
+  if (n >= (int)sizeof(name))
+    return fail(c, "name too long");
+  memcpy(name, start, n);
+  name[n] = '\0';
+
+  if (strcmp(name, "lut_sin") == 0)
+    return parse_call(c, OP_SIN);
+  if (strcmp(name, "lut_cos") == 0)
+    return parse_call(c, OP_COS);
+  if (strcmp(name, "abs") == 0)
+    return parse_call(c, OP_ABS);
+  if (strcmp(name, "ANGLE_UNIT") == 0)
+    return new_node(c, OP_CONST, -1, -1, ANGLE_UNIT);
+  for (i = 0; i < NUM_VARS; ++i)
+    if (strcmp(name, var_names[i]) == 0)
+      {
+	if (i == VAR_DIST)
+	  c->up->uses |= USERPAT_USES_DIST;
+	if (i == VAR_ANGLE)
+	  c->up->uses |= USERPAT_USES_ANGLE;
+	return new_node(c, OP_VAR, -1, -1, i);
+      }
+  c->s = start;
+  return fail(c, "unknown name");
+}
+
+/* Left associative, C precedence from '|' (level 0) up to '*' */
+static int parse_binary(Compiler *c, int level)
+{
+  int lhs, i, op, len;
+
+  if (level > TOP_LEVEL)
+    return parse_unary(c);
+  lhs = parse_binary(c, level + 1);
+  for (;;)
+    {
+      skip_space(c);
+      op = -1;
+      len = 0;
+      for (i = 0; i < NUM_BINARY_OPS; ++i)
+	if (binary_ops[i].level == level &&
+	    strncmp(c->s, binary_ops[i].tok, strlen(binary_ops[i].tok)) == 0)
+	  {
+	    op = binary_ops[i].op;
+	    len = (int)strlen(binary_ops[i].tok);
+	    break;
+	  }
+      if (op < 0 || c->err)
+	return lhs;
+      c->s += len;
+      lhs = new_node(c, op, lhs, parse_binary(c, level + 1), 0);
+    }
+}
+
+/* Row program: every node gets its own slot */
+static int emit_row(Compiler *c, int n)
+{
+  const Node *nd = &c->node[n];
+  UserPattern *up = c->up;
+  Insn in;
+
+  memset(&in, 0, sizeof(in));
+  in.op = nd->op;
+  in.k = nd->k;
+  if (nd->a >= 0)
+    in.a = in.b = emit_row(c, nd->a);
+  if (nd->b >= 0)
+    in.b = emit_row(c, nd->b);
+  if (up->nrow == USERPAT_CODE || up->nslots == USERPAT_SLOTS)
+    return fail(c, "expression too long"), 0;
+  in.dst = up->nslots++;
+  up->row[up->nrow++] = in;
+  return in.dst;
+}
+
+static int alloc_reg(Compiler *c)
+{
+  int r;
+
+  for (r = 0; r < USERPAT_REGS; ++r)
+    if (!(c->regs & (1u << r)))
+      {
+	c->regs |= 1u << r;
+	return r;
+      }
+  return fail(c, "expression too deeply nested"), 0;
+}
+
+static void free_reg(Compiler *c, int r)
+{
+  c->regs &= ~(1u << r);
+}
+
+/* Vector program for a node that varies along the row. The destination is
+ * taken before the sources are given back, so an instruction never writes
+ * a register it reads.
+ */
+static int emit_vec(Compiler *c, int n)
+{
+  const Node *nd = &c->node[n];
+  UserPattern *up = c->up;
+  Insn in;
+
+  memset(&in, 0, sizeof(in));
+  in.op = nd->op;
+  in.k = nd->k;
+  if (IS_BINARY(nd->op))
+    {
+      const int va = c->node[nd->a].varying, vb = c->node[nd->b].varying;
+
+      in.form = (va && vb) ? FORM_VV : va ? FORM_VU : FORM_UV;
+      if (va && vb && c->node[nd->b].regs > c->node[nd->a].regs)
+	{
+	  in.b = emit_vec(c, nd->b);
+	  in.a = emit_vec(c, nd->a);
+	}
+      else
+	{
+	  in.a = va ? emit_vec(c, nd->a) : emit_row(c, nd->a);
+	  in.b = vb ? emit_vec(c, nd->b) : emit_row(c, nd->b);
+	}
+      in.dst = alloc_reg(c);
+      if (va)
+	free_reg(c, in.a);
+      if (vb)
+	free_reg(c, in.b);
+    }
+  else if (nd->op == OP_VAR)
+    in.dst = alloc_reg(c);
+  else
+    {
+      in.a = emit_vec(c, nd->a);
+      in.dst = alloc_reg(c);
+      free_reg(c, in.a);
+    }
+  if (up->nvec == USERPAT_CODE)
+    return fail(c, "expression too long"), 0;
+  up->vec[up->nvec++] = in;
+  return in.dst;
+}
+
+/* NULL, or what is wrong with text and *where it is */
+static const char *compile(UserPattern *up, const char *text, const char **where)
+{
+  Compiler *c = (Compiler *)calloc(1, sizeof(Compiler));
+  const char *err;
+  int root;
+
+  if (!c)
+    return "out of memory";
+  c->s = text;
+  c->up = up;
+  root = parse_binary(c, 0);
+  skip_space(c);
+  if (*c->s)
+    fail(c, "unexpected text");
+  if (!c->err)
+    {
+      up->varying = c->node[root].varying;
+      up->result = up->varying ? emit_vec(c, root) : emit_row(c, root);
+    }
+  err = c->err;
+  *where = c->s;
+  free(c);
+  return err;
+}
+
+int userpat_load(const char *path)
+{
+  char line[USERPAT_LINE], *s, *eq, *end;
+  const char *err, *where;
+  UserPattern *up;
+  FILE *f;
+  int lineno = 0;
+
+  if (!(f = fopen(path, "r")))
+    {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return -1;
+    }
+  while (fgets(line, sizeof(line), f))
+    {
+      ++lineno;
+      if ((s = strchr(line, '#')) != NULL)
+	*s = '\0';
+      for (s = line; isspace((unsigned char)*s); ++s)
+	;
+      if (*s == '\0')
+	continue;
+
+      err = NULL;
+      where = s;
+      if (npatterns == USERPAT_MAX)
+	err = "too many patterns";
+      else if ((eq = strchr(s, '=')) == NULL)
+	err = "expected name = expression";
+      if (err)
+	break;
+
+      for (end = eq; end > s && isspace((unsigned char)end[-1]); --end)
+	;
+      *end = '\0';
+      if (!(up = (UserPattern *)calloc(1, sizeof(UserPattern))))
+	{
+	  err = "out of memory";
+	  break;
+	}
+      snprintf(up->name, sizeof(up->name), "%.*s", USERPAT_NAME - 1, s);
+      if ((err = compile(up, eq + 1, &where)) != NULL)
+	{
+	  free(up);
+	  break;
+	}
+      patterns[npatterns++] = up;
+    }
+  fclose(f);
+
+  if (err)
+    {
+      fprintf(stderr, "%s:%d: %s near \"%.*s\"\n", path, lineno, err,
+	      (int)strcspn(where, "\r\n"), where);
+      return -1;
+    }
+  return npatterns;
+}
+
+int userpat_count(void)
+{
+  return npatterns;
+}
+
+const UserPattern *userpat_get(int imageFuncNum)
+{
+  if (imageFuncNum < USERPAT_FIRST || imageFuncNum >= USERPAT_FIRST + npatterns)
+    return NULL;
+  return patterns[imageFuncNum - USERPAT_FIRST];
+}
+
+const char *userpat_name(const UserPattern *up)
+{
+  return up->name;
+}
+
+int userpat_uses(const UserPattern *up)
+{
+  return up->uses;
+}
+
+
+/* Running */
+
+static int32_t row_var(int v, const GenParams *p, long y)
+{
+  switch (v)
+    {
+    case VAR_Y:    return (int32_t)y;
+    case VAR_DY:   return (int32_t)(y - p->ycenter);
+    case VAR_XMAX: return p->xmax;
+    case VAR_YMAX: return p->ymax;
+    case VAR_X1:   return (int32_t)p->x1;
+    case VAR_X2:   return (int32_t)p->x2;
+    case VAR_X3:   return (int32_t)p->x3;
+    case VAR_X4:   return (int32_t)p->x4;
+    case VAR_Y1:   return (int32_t)p->y1;
+    case VAR_Y2:   return (int32_t)p->y2;
+    case VAR_Y3:   return (int32_t)p->y3;
+    case VAR_Y4:   return (int32_t)p->y4;
+    case VAR_A1:   return (int32_t)p->a1;
+    case VAR_A2:   return (int32_t)p->a2;
+    case VAR_A3:   return (int32_t)p->a3;
+    case VAR_A4:   return (int32_t)p->a4;
+    }
+  return 0;
+}
+
+static int32_t row_op(const Insn *in, const int32_t *u)
+{
+  const int32_t a = u[in->a], b = u[in->b];
+
+  switch (in->op)
+    {
+#define X(name, expr) case OP_##name: return op_##name(a, b);
+      BINARY_OPS(X)
+      UNARY_OPS(X)
+#undef X
+    }
+  return 0;
+}
+
+/* Lanes past the end of the row are loaded as zero and go along for the
+ * ride, so every other loop runs a fixed USERPAT_LANES times and
+ * vectorizes.
+ */
+static void vec_load(const Insn *in, int32_t *restrict d, long x0, long xstep, long n,
+		     long xcenter, const uint16_t *dist, const uint16_t *angle)
+{
+  long i;
+
+  if (xstep == 1 && n == USERPAT_LANES)
+    {
+      /* The usual case, as loops of fixed length */
+      if (in->k == VAR_DIST)
+	for (i = 0; i < USERPAT_LANES; ++i)
+	  d[i] = dist[x0 + i];
+      else if (in->k == VAR_ANGLE)
+	for (i = 0; i < USERPAT_LANES; ++i)
+	  d[i] = angle[x0 + i];
+      else
+	for (i = 0; i < USERPAT_LANES; ++i)
+	  d[i] = (int32_t)(x0 + i - ((in->k == VAR_DX) ? xcenter : 0));
+      return;
+    }
+
+  switch (in->k)
+    {
+    case VAR_X:
+      for (i = 0; i < n; ++i)
+	d[i] = (int32_t)(x0 + i * xstep);
+      break;
+    case VAR_DX:
+      for (i = 0; i < n; ++i)
+	d[i] = (int32_t)(x0 + i * xstep - xcenter);
+      break;
+    case VAR_DIST:
+      for (i = 0; i < n; ++i)
+	d[i] = dist[x0 + i * xstep];
+      break;
+    default:
+      for (i = 0; i < n; ++i)
+	d[i] = angle[x0 + i * xstep];
+      break;
+    }
+  for (i = n; i < USERPAT_LANES; ++i)
+    d[i] = 0;
+}
+
+static void vec_binary(const Insn *in, int32_t *restrict d, const int32_t *va, const int32_t *vb,
+		       int32_t ua, int32_t ub)
+{
+  int i;
+
+  switch (in->op)
+    {
+#define X(name, expr)							\
+    case OP_##name:							\
+      if (in->form == FORM_VV)						\
+	for (i = 0; i < USERPAT_LANES; ++i)				\
+	  d[i] = op_##name(va[i], vb[i]);				\
+      else if (in->form == FORM_VU)					\
+	for (i = 0; i < USERPAT_LANES; ++i)				\
+	  d[i] = op_##name(va[i], ub);					\
+      else								\
+	for (i = 0; i < USERPAT_LANES; ++i)				\
+	  d[i] = op_##name(ua, vb[i]);					\
+      break;
+      BINARY_OPS(X)
+#undef X
+    }
+}
+
+static void vec_unary(const Insn *in, int32_t *restrict d, const int32_t *va)
+{
+  int i;
+
+  switch (in->op)
+    {
+    case OP_SIN:
+      lut_sin_span (va, USERPAT_LANES, d);
+      break;
+    case OP_COS:
+      for (i = 0; i < USERPAT_LANES; ++i)
+	d[i] = (int32_t)((uint32_t)va[i] + ANGLE_UNIT_QUART);
+      lut_sin_span (d, USERPAT_LANES, d);
+      break;
+    case OP_NEG:
+      for (i = 0; i < USERPAT_LANES; ++i)
+	d[i] = op_NEG(va[i], 0);
+      break;
+    case OP_NOT:
+      for (i = 0; i < USERPAT_LANES; ++i)
+	d[i] = op_NOT(va[i], 0);
+      break;
+    case OP_ABS:
+      for (i = 0; i < USERPAT_LANES; ++i)
+	d[i] = op_ABS(va[i], 0);
+      break;
+    }
+}
+
+void userpat_row(const UserPattern *up, const GenParams *p, long y, long xend, long xstep,
+		 const uint16_t *dist, const uint16_t *angle, int *color)
+{
+  int32_t u[USERPAT_SLOTS];
+  int32_t reg[USERPAT_REGS][USERPAT_LANES];
+  const Insn *in;
+  long x0, i, n;
+
+  for (in = up->row; in < up->row + up->nrow; ++in)
+    {
+      if (in->op == OP_CONST)
+	u[in->dst] = in->k;
+      else if (in->op == OP_VAR)
+	u[in->dst] = row_var(in->k, p, y);
+      else
+	u[in->dst] = row_op(in, u);
+    }
+
+  if (!up->varying)
+    {
+      for (x0 = 0; x0 < xend; x0 += xstep)
+	color[x0] = u[up->result];
+      return;
+    }
+
+  for (x0 = 0; x0 < xend; x0 += USERPAT_LANES * xstep)
+    {
+      n = MIN(USERPAT_LANES, (xend - x0 + xstep - 1) / xstep);
+      for (in = up->vec; in < up->vec + up->nvec; ++in)
+	{
+	  if (in->op == OP_VAR)
+	    vec_load(in, reg[in->dst], x0, xstep, n, p->xcenter, dist, angle);
+	  else if (IS_BINARY(in->op))
+	    vec_binary(in, reg[in->dst],
+		       (in->form == FORM_UV) ? NULL : reg[in->a],
+		       (in->form == FORM_VU) ? NULL : reg[in->b],
+		       (in->form == FORM_UV) ? u[in->a] : 0,
+		       (in->form == FORM_VU) ? u[in->b] : 0);
+	  else
+	    vec_unary(in, reg[in->dst], reg[in->a]);
+	}
+      if (xstep == 1 && n == USERPAT_LANES)
+	memcpy (color + x0, reg[up->result], sizeof(reg[0]));
+      else
+	for (i = 0; i < n; ++i)
+	  color[x0 + i * xstep] = reg[up->result][i];
+    }
+}
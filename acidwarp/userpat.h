@@ -0,0 +1,52 @@
+#ifndef USERPAT_H
+#define USERPAT_H
+
+#include <stdint.h>
+
+#include "generate.h"
+
+/* Patterns loaded from a text file (--pattern-file) instead of compiled in.
+ * Each line is "name = expression", with C integer operators over
+ *
+ *   x, y        the pixel
+ *   dx, dy      the pixel relative to the centre
+ *   dist, angle lut_dist (dx, dy) and lut_angle (dx, dy)
+ *   xmax, ymax  the screen size
+ *   x1..x4, y1..y4, a1..a4
+ *               the random parameters the classic patterns use
+ *   ANGLE_UNIT
+ *
+ * and the functions lut_sin(), lut_cos() and abs(). '#' starts a comment.
+ * The color is wrapped into the palette like any classic pattern's.
+ *
+ * Expressions are compiled once, at load time, into a small register
+ * bytecode. The parts that only depend on the row are worked out once per
+ * row; the rest runs over USERPAT_LANES pixels per instruction, in loops
+ * the compiler vectorizes. Arithmetic is 32 bit and wraps; dividing by
+ * zero gives zero.
+ */
+#define USERPAT_FIRST 100     /* imageFuncNum of the first loaded pattern */
+#define USERPAT_MAX   64
+
+typedef struct UserPattern UserPattern;
+
+/* The number of patterns loaded, or -1 after printing what was wrong */
+int  userpat_load(const char *path);
+int  userpat_count(void);
+/* NULL if imageFuncNum is not a loaded pattern */
+const UserPattern *userpat_get(int imageFuncNum);
+const char *userpat_name(const UserPattern *up);
+
+#define USERPAT_USES_DIST   1
+#define USERPAT_USES_ANGLE  2
+int  userpat_uses(const UserPattern *up);
+
+/* Writes the raw color of columns 0, xstep, 2*xstep, ... below xend of row
+ * y into color[], the way the classic row kernels do. dist and angle are
+ * that row's lut_dist() and lut_angle() by column, needed only if the
+ * pattern uses them.
+ */
+void userpat_row(const UserPattern *up, const GenParams *p, long y, long xend, long xstep,
+                 const uint16_t *dist, const uint16_t *angle, int *color);
+
+#endif // USERPAT_H
@@ -0,0 +1,141 @@
+/* Worker thread pool used to spread image generation across CPU cores. */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+
+#include "workpool.h"
+
+#define WORKPOOL_MAX_THREADS 64
+
+static pthread_t       pool_threads[WORKPOOL_MAX_THREADS];
+static int             pool_nthreads = 1;     /* caller included */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_busy = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  pool_done = PTHREAD_COND_INITIALIZER;
+
+/* Current job, protected by pool_lock */
+static workpool_fn pool_fn;
+static void       *pool_ctx;
+static int         pool_ntasks;
+static int         pool_next;
+static int         pool_finished;
+static unsigned    pool_generation;
+static int         pool_quit;
+
+/* Hand out tasks until none are left. Called with pool_lock held. */
+static void take_tasks(void)
+{
+  while (pool_next < pool_ntasks)
+    {
+      int task = pool_next++;
+      workpool_fn fn = pool_fn;
+      void *ctx = pool_ctx;
+
+      pthread_mutex_unlock(&pool_lock);
+      fn(ctx, task);
+      pthread_mutex_lock(&pool_lock);
+
+      if (++pool_finished == pool_ntasks)
+        pthread_cond_broadcast(&pool_done);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+  unsigned seen = 0;
+
+  (void)arg;
+  pthread_mutex_lock(&pool_lock);
+  for (;;)
+    {
+      while (!pool_quit && pool_generation == seen)
+        pthread_cond_wait(&pool_wake, &pool_lock);
+      if (pool_quit)
+        break;
+      seen = pool_generation;
+      take_tasks();
+    }
+  pthread_mutex_unlock(&pool_lock);
+  return NULL;
+}
+
+int workpool_cpu_count(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n < 1) ? 1 : (int)n;
+}
+
+void workpool_init(int nthreads)
+{
+  int i;
+
+  workpool_shutdown();
+  if (nthreads <= 0)
+    nthreads = workpool_cpu_count();
+  if (nthreads > WORKPOOL_MAX_THREADS)
+    nthreads = WORKPOOL_MAX_THREADS;
+
+  pool_quit = 0;
+  pool_nthreads = 1;
+  for (i = 1; i < nthreads; ++i)
+    {
+      if (pthread_create(&pool_threads[i], NULL, worker_main, NULL) != 0)
+        break;
+      ++pool_nthreads;
+    }
+}
+
+int workpool_size(void)
+{
+  return pool_nthreads;
+}
+
+void workpool_run(workpool_fn fn, void *ctx, int ntasks)
+{
+  int task;
+
+  if (ntasks <= 0)
+    return;
+
+  /* Single threaded, a single task, or someone else owns the pool */
+  if (pool_nthreads == 1 || ntasks == 1 || pthread_mutex_trylock(&pool_busy) != 0)
+    {
+      for (task = 0; task < ntasks; ++task)
+        fn(ctx, task);
+      return;
+    }
+
+  pthread_mutex_lock(&pool_lock);
+  pool_fn = fn;
+  pool_ctx = ctx;
+  pool_ntasks = ntasks;
+  pool_next = 0;
+  pool_finished = 0;
+  ++pool_generation;
+  pthread_cond_broadcast(&pool_wake);
+
+  take_tasks();
+  while (pool_finished < pool_ntasks)
+    pthread_cond_wait(&pool_done, &pool_lock);
+  pthread_mutex_unlock(&pool_lock);
+
+  pthread_mutex_unlock(&pool_busy);
+}
+
+void workpool_shutdown(void)
+{
+  int i;
+
+  if (pool_nthreads <= 1)
+    return;
+
+  pthread_mutex_lock(&pool_lock);
+  pool_quit = 1;
+  pthread_cond_broadcast(&pool_wake);
+  pthread_mutex_unlock(&pool_lock);
+
+  for (i = 1; i < pool_nthreads; ++i)
+    pthread_join(pool_threads[i], NULL);
+  pool_nthreads = 1;
+}
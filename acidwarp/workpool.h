@@ -0,0 +1,17 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+/* A small fork/join pool of worker threads. workpool_run() hands out task
+ * numbers 0..ntasks-1 to the workers and to the calling thread, and returns
+ * when every task has finished. If the pool is already busy (for example the
+ * background generator is using it), the tasks simply run on the caller.
+ */
+typedef void (*workpool_fn)(void *ctx, int task);
+
+void workpool_init(int nthreads);  /* nthreads <= 0 means one per CPU */
+int  workpool_size(void);          /* threads taking part, caller included */
+void workpool_run(workpool_fn fn, void *ctx, int ntasks);
+void workpool_shutdown(void);
+int  workpool_cpu_count(void);
+
+#endif // WORKPOOL_H